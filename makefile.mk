@@ -1,4 +1,36 @@
-pq.o: pc1.c pc.h
-    gcc -c pq1.c
-test: test.c pq.o
-    gcc test.c pq.o -o test
\ No newline at end of file
+OBJS = pq.o pq_pairing.o pq_radix.o pq_concurrent.o pq_multiqueue.o pq_compact.o pq_wheel.o pq_bucket.o pq_minmax.o
+
+pq.o: pq.c pq.h pq_engine.h pq_sift.h
+	gcc $(CFLAGS) -c pq.c
+pq_pairing.o: pq_pairing.c pq.h pq_engine.h
+	gcc -c pq_pairing.c
+pq_radix.o: pq_radix.c pq.h pq_engine.h
+	gcc -c pq_radix.c
+pq_concurrent.o: pq_concurrent.c pq.h pq_engine.h
+	gcc -c pq_concurrent.c
+pq_multiqueue.o: pq_multiqueue.c pq.h pq_engine.h
+	gcc -c pq_multiqueue.c
+pq_compact.o: pq_compact.c pq.h pq_engine.h
+	gcc -c pq_compact.c
+pq_wheel.o: pq_wheel.c pq.h pq_engine.h
+	gcc -c pq_wheel.c
+pq_bucket.o: pq_bucket.c pq.h pq_engine.h
+	gcc -c pq_bucket.c
+pq_minmax.o: pq_minmax.c pq.h pq_engine.h
+	gcc -c pq_minmax.c
+pq_shim.o: pq_shim.cpp pq.hpp pq.h
+	g++ $(CFLAGS) -c pq_shim.cpp
+test: test.c $(OBJS)
+	gcc test.c $(OBJS) -o test -pthread -lm
+pq_bench_mt: pq_bench_mt.c $(OBJS)
+	gcc -O2 pq_bench_mt.c $(OBJS) -o pq_bench_mt -pthread -lm
+pq_bench: pq_bench.c $(OBJS)
+	gcc -O2 pq_bench.c $(OBJS) -o pq_bench -pthread -lm
+pq_bench_timer: pq_bench_timer.c $(OBJS)
+	gcc -O2 pq_bench_timer.c $(OBJS) -o pq_bench_timer -pthread -lm
+pq_bench_build: pq_bench_build.c $(OBJS)
+	gcc -O2 pq_bench_build.c $(OBJS) -o pq_bench_build -pthread -lm
+pq_stress: pq_stress.c $(OBJS)
+	gcc -O2 pq_stress.c $(OBJS) -o pq_stress -pthread -lm
+pq_fuzz: pq_stress.c pq.c pq_pairing.c pq_radix.c pq_concurrent.c pq_multiqueue.c pq_compact.c pq_wheel.c pq_bucket.c pq_minmax.c pq.h pq_engine.h pq_sift.h
+	clang -g -O1 -fsanitize=fuzzer,address -DPQ_FUZZ pq_stress.c pq.c pq_pairing.c pq_radix.c pq_concurrent.c pq_multiqueue.c pq_compact.c pq_wheel.c pq_bucket.c pq_minmax.c -o pq_fuzz -pthread -lm
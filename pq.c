@@ -1,22 +1,239 @@
 #include "pq.h"
+#include "pq_engine.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#include <pthread.h>
 
-typedef struct node_struct {
-	int id; 	//integers in the range 
-	int position; //values 
-	double priority; //index in the heap
-	
-}NODE;
+/* children per heap node. 2 gives the classic binary heap; build with
+ * -DPQ_ARITY=4, 8 or 16 for a shallower d-ary heap where each
+ * sift-down level scans one contiguous block of children.
+ */
+#ifndef PQ_ARITY
+#define PQ_ARITY 2
+#endif
 
+#define PQ_CACHE_LINE 64
+
+/* vector child selection (see best_avx2) for wide heaps on x86-64,
+ * picked at run time from what the cpu supports. -DPQ_NO_SIMD keeps
+ * the scalar scan.
+ */
+#if (PQ_ARITY == 4 || PQ_ARITY == 8 || PQ_ARITY == 16) && defined(__x86_64__) && defined(__GNUC__) && !defined(PQ_NO_SIMD)
+#define PQ_SIMD
+#include <immintrin.h>
+#endif
+
+//largest capacity a growable queue reserves address space for
+#ifndef PQ_MAX_CAPACITY
+#define PQ_MAX_CAPACITY (1 << 28)
+#endif
+
+/* opt-in instrumentation: STAT(...) keeps its argument only in builds
+ * with -DPQ_STATS, so the counting vanishes from the normal build.
+ */
+#ifdef PQ_STATS
+#define STAT(...)	__VA_ARGS__
+#else
+#define STAT(...)
+#endif
+
+/* index math for the 1-based d-ary heap. FIRST_CHILD is a long: the
+ * children of the last nodes of a large 8-ary heap lie past INT_MAX
+ */
+#define PARENT(i)	(((i) - 2) / PQ_ARITY + 1)
+#define FIRST_CHILD(i)	(((long)(i) - 1) * PQ_ARITY + 2)
+
+/* the heap is kept as parallel arrays (structure of arrays): sifts compare
+ * only the contiguous priority array, and ids are mapped back to their heap
+ * slot by a 32-bit index rather than a pointer, so nothing refers to the
+ * address of the storage.
+ */
 struct pq_struct{
-	NODE *heap;		//array of nodes that hold an id and a priority
-	NODE **nodePtrs;//array of pointers to corresponding ids
+	double *prio;	//priorities in heap order, index 0 unused
+	int *ids;		//ids in heap order, parallel to prio
+	int *pos;		//heap index of every id, 0 if the id is not in the queue
+	void *mem;		//raw allocation behind prio (prio is aligned inside it)
+	size_t map_len;	//length of the mapping behind a growable or image queue, 0 otherwise
+	struct pq_image *image;	//header of the mapped image the arrays live in, NULL otherwise
+	int shared;		//image changes go back to the file or segment (see pq_sync)
+	int in_region;	//this struct lives at the start of a pq_create_in region
+	void (*release)(void *mem, size_t bytes, void *ctx);	//frees that region, NULL if the caller keeps it
+	void *release_ctx;
 	int size;		//current size
 	int capacity;	//capacity of the nodes
 	int type; 		//max or min heap depending on the configration
+	int growable;	//grow capacity on insert instead of rejecting large ids
+	int k;			//bound of a pq_create_topk queue, 0 otherwise
+	double threshold;	//prio[1] while a top-K queue is full, NAN when not full or stale
+	unsigned char *dead;	//per id, 1 while its entry is a tombstone; NULL unless removal is lazy
+	int dead_room;	//ids dead covers
+	int ndead;		//tombstones in the heap, counted in size
+	double max_dead;	//share of size the tombstones may reach before a compaction
+	const PQ_ENGINE *engine;	//alternative implementation, NULL for the array heap
+	void *impl;		//state of the engine
+#ifdef PQ_STATS
+	PQ_COUNTERS stats;
+	int stat_op;	//PQ_STAT_* kind the running sifts are counted under
+#endif
 };
 
+//doubles skipped at the front of prio so prio[2] starts a cache line
+#define PRIO_LEAD	((int)(PQ_CACHE_LINE / sizeof(double)) - 2)
+
+/* allocates heap arrays for the given capacity on the malloc heap.
+ * returns 0 if out of memory.
+ */
+static int alloc_arrays(PQ *p, int capacity){
+	if(posix_memalign(&p->mem, PQ_CACHE_LINE, sizeof(double) * ((size_t)capacity + 1 + PRIO_LEAD)) != 0)
+		return 0;
+	p->prio = (double *)p->mem + PRIO_LEAD;
+	//create id array
+	p->ids = malloc(sizeof(int) * ((size_t)capacity + 1));
+	//create position array, every id starts out of the queue
+	p->pos = calloc(capacity, sizeof(int));
+	p->map_len = 0;
+	return p->ids != NULL && p->pos != NULL;
+}
+
+/* reserves address space for PQ_MAX_CAPACITY ids without committing
+ * memory. the kernel backs pages with zeroes as they are first touched,
+ * so the arrays never move and growing is just raising the capacity.
+ * returns 0 if the reservation is refused.
+ */
+static int map_arrays(PQ *p){
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t prio_len = sizeof(double) * ((size_t)PQ_MAX_CAPACITY + 1 + PRIO_LEAD);
+	size_t ids_len = sizeof(int) * ((size_t)PQ_MAX_CAPACITY + 1);
+	size_t pos_len = sizeof(int) * (size_t)PQ_MAX_CAPACITY;
+
+	//page align each section
+	prio_len = (prio_len + page - 1) / page * page;
+	ids_len = (ids_len + page - 1) / page * page;
+	pos_len = (pos_len + page - 1) / page * page;
+
+	void *mem = mmap(NULL, prio_len + ids_len + pos_len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(mem == MAP_FAILED)
+		return 0;
+	p->mem = mem;
+	p->map_len = prio_len + ids_len + pos_len;
+	p->prio = (double *)mem + PRIO_LEAD;
+	p->ids = (int *)((char *)mem + prio_len);
+	p->pos = (int *)((char *)mem + prio_len + ids_len);
+	return 1;
+}
+
+//writes to every page in [from, from+len) so later stores do not fault
+static void touch_pages(void *from, size_t len){
+	size_t page = sysconf(_SC_PAGESIZE);
+	volatile char *c = from;
+	size_t i;
+	for(i = 0; i < len; i += page)
+		c[i] = 0;
+}
+
+/* makes the tombstone flags (if any) cover the ids below capacity,
+ * doubling their room as needed. returns 0 if out of memory.
+ */
+static int fit_dead(PQ *pq, int capacity){
+	unsigned char *dead;
+	int room = pq->dead_room;
+	if(pq->dead == NULL || capacity <= room)
+		return 1;
+	while(room < capacity)
+		room = room < PQ_MAX_CAPACITY / 2 ? 2 * room : PQ_MAX_CAPACITY;
+	dead = realloc(pq->dead, room);
+	if(dead == NULL)
+		return 0;
+	memset(dead + pq->dead_room, 0, room - pq->dead_room);
+	pq->dead = dead;
+	pq->dead_room = room;
+	return 1;
+}
+
+/* moves a malloc backed queue to larger arrays. this copies the heap,
+ * so it is only used by pq_reserve on fixed queues and as the fallback
+ * when a growable queue could not reserve address space.
+ */
+static int realloc_arrays(PQ *pq, int capacity){
+	void *mem;
+	if(!fit_dead(pq, capacity))
+		return 0;
+	if(posix_memalign(&mem, PQ_CACHE_LINE, sizeof(double) * ((size_t)capacity + 1 + PRIO_LEAD)) != 0)
+		return 0;
+	int *ids = realloc(pq->ids, sizeof(int) * ((size_t)capacity + 1));
+	if(ids == NULL){
+		free(mem);
+		return 0;
+	}
+	pq->ids = ids;
+	int *pos = realloc(pq->pos, sizeof(int) * capacity);
+	if(pos == NULL){
+		free(mem);
+		return 0;
+	}
+	pq->pos = pos;
+	memset(pos + pq->capacity, 0, sizeof(int) * (capacity - pq->capacity));
+	memcpy((double *)mem + PRIO_LEAD, pq->prio, sizeof(double) * (pq->size + 1));
+	free(pq->mem);
+	pq->mem = mem;
+	pq->prio = (double *)mem + PRIO_LEAD;
+	pq->capacity = capacity;
+	return 1;
+}
+
+
+/* makes id valid on a growable queue. a reserved mapping already covers
+ * the id, so only the capacity moves; otherwise the arrays are doubled.
+ * returns 0 if the queue is fixed or cannot grow that far.
+ */
+static int grow_to(PQ *pq, int id){
+	if(!pq->growable || PQ_MAX_CAPACITY <= id)
+		return 0;
+	if(pq->map_len != 0){
+		if(!fit_dead(pq, id + 1))
+			return 0;
+		pq->capacity = id + 1;
+		return 1;
+	}
+	return realloc_arrays(pq, id < PQ_MAX_CAPACITY / 2 ? 2 * id + 1 : PQ_MAX_CAPACITY);
+}
+
+#ifdef PQ_STATS
+//log2 histogram bucket of v (see pq.h)
+static int stat_bucket(unsigned v){
+	return v == 0 ? 0 : 32 - __builtin_clz(v);
+}
+
+/* counts the start of an operation and the size it found the queue at.
+ * purges are housekeeping, not calls, so they stay out of the histograms
+ */
+static void stat_begin(PQ *pq, int op){
+	pq->stat_op = op;
+	pq->stats.ops[op].calls++;
+	if(op != PQ_STAT_PURGE)
+		pq->stats.size[stat_bucket(pq->size)]++;
+}
+
+//counts one sift of the running operation
+static void stat_sift(PQ *pq, int levels, int compares){
+	PQ_OP_COUNTERS *c = &pq->stats.ops[pq->stat_op];
+	c->levels += levels;
+	c->compares += compares;
+	c->moves += levels + 1;
+	if(pq->stat_op != PQ_STAT_BULK && pq->stat_op != PQ_STAT_PURGE)
+		pq->stats.depth[stat_bucket(levels)]++;
+}
+#endif
 
 PQ * pq_create(int capacity, int min_heap){
 	if(0 >= capacity){
@@ -25,347 +242,1620 @@ PQ * pq_create(int capacity, int min_heap){
 	}
 	//create priority queue
 	PQ *p = malloc(sizeof(PQ));
-	
-	//create heap
-	p->heap = malloc(sizeof(NODE) * capacity+1);
+
+	//create heap arrays
+	if(!alloc_arrays(p, capacity)){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
 	//set index 0 of heap to -1
-	p->heap[0].id = -1;
-	p->heap[0].priority = -1;
-	
-	//create node pointer array
-	p->nodePtrs = malloc(sizeof(NODE*) *capacity);
-	//set pointers to point to NULL
-	int i = 0;
-	for(i = 0; i < capacity; i++)
-		p->nodePtrs[i] = NULL;
-	
+	p->ids[0] = -1;
+	p->prio[0] = -1;
+
 	//set capacity, size, and heap type
 	p->capacity = capacity; //set max capacity
 	p->size = 0; //set starting number of elements in tree to 0
-	p->type = min_heap; //starts at 0 so 
+	p->type = min_heap; //starts at 0 so
+	p->growable = 0;
+	p->k = 0;
+	p->threshold = NAN;
+	p->dead = NULL;
+	p->ndead = 0;
+	p->engine = NULL;
+	p->image = NULL;
+	p->in_region = 0;
+	STAT(memset(&p->stats, 0, sizeof(p->stats));)
+
+	return p;
+}
+
+PQ * pq_create_growable(int capacity, int min_heap){
+	if(0 >= capacity || PQ_MAX_CAPACITY < capacity){
+		printf("Capacity must be between 1 and %d!\n", PQ_MAX_CAPACITY);
+		exit(1);
+	}
+	PQ *p = malloc(sizeof(PQ));
+
+	//fall back to malloc'd arrays (grown by copying) if the
+	//address space cannot be reserved
+	if(!map_arrays(p) && !alloc_arrays(p, capacity)){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	p->ids[0] = -1;
+	p->prio[0] = -1;
 
+	p->capacity = capacity;
+	p->size = 0;
+	p->type = min_heap;
+	p->growable = 1;
+	p->k = 0;
+	p->threshold = NAN;
+	p->dead = NULL;
+	p->ndead = 0;
+	p->engine = NULL;
+	p->image = NULL;
+	p->in_region = 0;
+	STAT(memset(&p->stats, 0, sizeof(p->stats));)
+
+	return p;
+}
+
+PQ * pq_create_topk(int capacity, int min_heap, int k){
+	PQ *p;
+	if(0 >= k || capacity < k){
+		printf("K must be between 1 and the capacity!\n");
+		exit(1);
+	}
+	p = pq_create(capacity, min_heap);
+	p->k = k;
 	return p;
 }
 
+PQ * pq_wrap(const PQ_ENGINE *engine, void *impl, int capacity, int min_heap){
+	PQ *p = malloc(sizeof(PQ));
+	//the heap arrays stay unused
+	p->prio = NULL;
+	p->ids = NULL;
+	p->pos = NULL;
+	p->mem = NULL;
+	p->map_len = 0;
+	p->size = 0;
+	p->capacity = capacity;
+	p->type = min_heap;
+	p->growable = 0;
+	p->k = 0;
+	p->threshold = NAN;
+	p->dead = NULL;
+	p->ndead = 0;
+	p->image = NULL;
+	p->in_region = 0;
+	p->engine = engine;
+	p->impl = impl;
+	return p;
+}
 
-void pq_free(PQ * pq){	
-	free(pq->heap);
-	free(pq->nodePtrs);
+int pq_reserve(PQ * pq, int capacity){
+	if(capacity <= pq->capacity)
+		return 1;
+	if(PQ_MAX_CAPACITY < capacity || pq->engine != NULL || pq->image != NULL || pq->in_region){
+		printf("ERROR: Capacity is out of Range!\n");
+		return 0;
+	}
+	//reserved mapping: fault the new range in now instead of on insert
+	if(pq->map_len != 0){
+		if(!fit_dead(pq, capacity)){
+			printf("ERROR: Out of memory!\n");
+			return 0;
+		}
+		touch_pages(pq->prio + pq->capacity + 1, sizeof(double) * (capacity - pq->capacity));
+		touch_pages(pq->ids + pq->capacity + 1, sizeof(int) * (capacity - pq->capacity));
+		touch_pages(pq->pos + pq->capacity, sizeof(int) * (capacity - pq->capacity));
+		pq->capacity = capacity;
+		return 1;
+	}
+	if(!realloc_arrays(pq, capacity)){
+		printf("ERROR: Out of memory!\n");
+		return 0;
+	}
+	return 1;
+}
+
+
+void pq_free(PQ * pq){
+	//the struct is part of the region, so nothing is left to free after it
+	if(pq->in_region){
+		if(pq->release != NULL)
+			pq->release(pq->mem, pq->map_len, pq->release_ctx);
+		return;
+	}
+	free(pq->dead);
+	if(pq->engine != NULL)
+		pq->engine->free(pq->impl);
+	else if(pq->image != NULL){
+		pq_sync(pq);
+		munmap(pq->mem, pq->map_len);
+	}
+	else if(pq->map_len != 0)
+		munmap(pq->mem, pq->map_len);
+	else {
+		free(pq->mem);
+		free(pq->ids);
+		free(pq->pos);
+	}
 	free(pq);
 }
 
 
+//1 if id's entry was removed lazily and is still in the heap
+static inline int tombstone(PQ *pq, int id){
+	return pq->dead != NULL && pq->dead[id];
+}
+
 void perculate_up(PQ *pq, int i){
-	//hold priority and id temporarily
-	double x = pq->heap[i].priority;
-	int d = pq->heap[i].id;
-	int pos = pq->heap[i].position;
-	//get the root node
-	int value = i/2;
-	
-	
+	//hold priority and id temporarily and move parents down into the hole
+	double x = pq->prio[i];
+	int d = pq->ids[i];
+	int parent;
+	STAT(int levels = 0;)
+
 	//for max-heap
 	if(pq->type == 0){
-		while(x > pq->heap[value].priority && value >= 1){
-			//swap the values 
-			pq->heap[i] = pq->heap[value];
-			pq->nodePtrs[pq->heap[value].id] = &(pq->heap[i]);
-			pq->nodePtrs[pq->heap[value].id] = &(pq->heap[i]);
-			//set the new value
-			i = value;
-			value = i/2;
-		}
-	}
-	//for min-heap 
-	else {	
-		while(x < pq->heap[value].priority && value >= 1){
-			//swap the values
-			pq->heap[i].priority = pq->heap[value].priority;
-			pq->heap[i].id = pq->heap[value].id;
-			pq->nodePtrs[pq->heap[value].id] = &(pq->heap[i]);
-			//set the new values of i and value
-			i = value;
-			value = i/2;
+		while(i > 1 && x > pq->prio[parent = PARENT(i)]){
+			pq->prio[i] = pq->prio[parent];
+			pq->ids[i] = pq->ids[parent];
+			pq->pos[pq->ids[i]] = i;
+			i = parent;
+			STAT(levels++;)
+		}
+	}
+	//for min-heap
+	else {
+		while(i > 1 && x < pq->prio[parent = PARENT(i)]){
+			pq->prio[i] = pq->prio[parent];
+			pq->ids[i] = pq->ids[parent];
+			pq->pos[pq->ids[i]] = i;
+			i = parent;
+			STAT(levels++;)
 		}
 	}
 	//set the index to temporary variables
-	pq->heap[i].priority = x;
-	pq->heap[i].id = d;
-	pq->nodePtrs[d] = &(pq->heap[i]);
+	pq->prio[i] = x;
+	pq->ids[i] = d;
+	pq->pos[d] = i;
+	//one compare per level, plus the one that stopped below the root
+	STAT(stat_sift(pq, levels, levels + (i > 1));)
 }
 
 int pq_insert(PQ * pq, int id, double priority){
+	if(pq->engine != NULL)
+		return pq->engine->insert(pq->impl, id, priority);
 	//id is out of range
-    if (id < 0 || pq->capacity <= id){  
-		printf("ERROR: ID is out of Range!\n");
-		return 0;
+    if (id < 0 || pq->capacity <= id){
+		if(id < 0 || !grow_to(pq, id)){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
 	}
 	//entry for the id already exists
-    if(pq->nodePtrs[id] != NULL){
+    if(pq->pos[id] != 0){
+		//a tombstone of the id is still in the heap: bring it back
+		if(tombstone(pq, id)){
+			pq->dead[id] = 0;
+			pq->ndead--;
+			return pq_change_priority(pq, id, priority);
+		}
 		printf("ERROR: ID is already occupied at the given position.\n");
 		return 0;
 	}
-	
+
+	STAT(stat_begin(pq, PQ_STAT_INSERT);)
+	//the top may move, so pq_offer must look at it again
+	pq->threshold = NAN;
 	//increase the size
 	pq->size = pq->size + 1;
-	pq->heap[pq->size].position = pq->size;
-	
+
 	//modify heap and array
-	pq->heap[pq->size].priority = priority;
-	pq->heap[pq->size].id = id;	
-	pq->nodePtrs[id] = &(pq->heap[pq->size]);
-	pq->heap[pq->size].position = pq->size;
-	
+	pq->prio[pq->size] = priority;
+	pq->ids[pq->size] = id;
+	pq->pos[id] = pq->size;
+
 	//function call to perculate up to reach the last node in the tree
 	perculate_up(pq, pq->size);
 	return 1;
 }
- 
+
 int pq_capacity(PQ * pq){
 	return pq->capacity;
 }
 
 int pq_size(PQ * pq){
-	return pq->size;
+	if(pq->engine != NULL)
+		return pq->engine->size(pq->impl);
+	return pq->size - pq->ndead;
+}
+//index of the best of the PQ_ARITY children at p, one compare at a time
+static inline int best_min_scalar(const double *p){
+	int k, best = 0;
+	for(k = 1; k < PQ_ARITY; k++)
+		if(p[k] < p[best])
+			best = k;
+	return best;
 }
+
+static inline int best_max_scalar(const double *p){
+	int k, best = 0;
+	for(k = 1; k < PQ_ARITY; k++)
+		if(p[k] > p[best])
+			best = k;
+	return best;
+}
+
+#define SIFT_NAME	sift_down_scalar
+#define SIFT_TARGET
+#define SIFT_MIN	best_min_scalar
+#define SIFT_MAX	best_max_scalar
+#include "pq_sift.h"
+#undef SIFT_NAME
+#undef SIFT_TARGET
+#undef SIFT_MIN
+#undef SIFT_MAX
+
+#ifdef PQ_SIMD
+/* vector child selection for 4, 8 and 16-ary heaps: reduce the block to
+ * its min (max) with vector compares, then take the first lane equal to
+ * it, which is the same child the scalar scan picks. the top lane bit is
+ * forced on so a block of NaNs still yields a valid index.
+ */
+__attribute__((target("avx2"))) static inline int best_avx2(const double *p, int min){
+#if PQ_ARITY == 4
+	__m256d v = _mm256_loadu_pd(p);
+	__m256d m = min ? _mm256_min_pd(v, _mm256_permute2f128_pd(v, v, 1))
+			: _mm256_max_pd(v, _mm256_permute2f128_pd(v, v, 1));
+	m = min ? _mm256_min_pd(m, _mm256_permute_pd(m, 5)) : _mm256_max_pd(m, _mm256_permute_pd(m, 5));
+	int mask = _mm256_movemask_pd(_mm256_cmp_pd(v, m, _CMP_EQ_OQ));
+#elif PQ_ARITY == 8
+	__m256d a = _mm256_loadu_pd(p);
+	__m256d b = _mm256_loadu_pd(p + 4);
+	__m256d m = min ? _mm256_min_pd(a, b) : _mm256_max_pd(a, b);
+	m = min ? _mm256_min_pd(m, _mm256_permute2f128_pd(m, m, 1))
+			: _mm256_max_pd(m, _mm256_permute2f128_pd(m, m, 1));
+	m = min ? _mm256_min_pd(m, _mm256_permute_pd(m, 5)) : _mm256_max_pd(m, _mm256_permute_pd(m, 5));
+	int mask = _mm256_movemask_pd(_mm256_cmp_pd(a, m, _CMP_EQ_OQ))
+			| _mm256_movemask_pd(_mm256_cmp_pd(b, m, _CMP_EQ_OQ)) << 4;
+#else
+	__m256d a = _mm256_loadu_pd(p);
+	__m256d b = _mm256_loadu_pd(p + 4);
+	__m256d c = _mm256_loadu_pd(p + 8);
+	__m256d d = _mm256_loadu_pd(p + 12);
+	__m256d m = min ? _mm256_min_pd(_mm256_min_pd(a, b), _mm256_min_pd(c, d))
+			: _mm256_max_pd(_mm256_max_pd(a, b), _mm256_max_pd(c, d));
+	m = min ? _mm256_min_pd(m, _mm256_permute2f128_pd(m, m, 1))
+			: _mm256_max_pd(m, _mm256_permute2f128_pd(m, m, 1));
+	m = min ? _mm256_min_pd(m, _mm256_permute_pd(m, 5)) : _mm256_max_pd(m, _mm256_permute_pd(m, 5));
+	int mask = _mm256_movemask_pd(_mm256_cmp_pd(a, m, _CMP_EQ_OQ))
+			| _mm256_movemask_pd(_mm256_cmp_pd(b, m, _CMP_EQ_OQ)) << 4
+			| _mm256_movemask_pd(_mm256_cmp_pd(c, m, _CMP_EQ_OQ)) << 8
+			| _mm256_movemask_pd(_mm256_cmp_pd(d, m, _CMP_EQ_OQ)) << 12;
+#endif
+	return __builtin_ctz(mask | 1 << (PQ_ARITY - 1));
+}
+
+#define SIFT_NAME	sift_down_avx2
+#define SIFT_TARGET	__attribute__((target("avx2")))
+#define SIFT_MIN(p)	best_avx2(p, 1)
+#define SIFT_MAX(p)	best_avx2(p, 0)
+#include "pq_sift.h"
+#undef SIFT_NAME
+#undef SIFT_TARGET
+#undef SIFT_MIN
+#undef SIFT_MAX
+
+#if PQ_ARITY >= 8
+//one register per 8 children; a 16-ary block folds its two halves first
+__attribute__((target("avx512f"))) static inline int best_avx512(const double *p, int min){
+#if PQ_ARITY == 8
+	__m512d v = _mm512_loadu_pd(p);
+	double m = min ? _mm512_reduce_min_pd(v) : _mm512_reduce_max_pd(v);
+	int mask = _mm512_cmp_pd_mask(v, _mm512_set1_pd(m), _CMP_EQ_OQ);
+#else
+	__m512d a = _mm512_loadu_pd(p);
+	__m512d b = _mm512_loadu_pd(p + 8);
+	double m = min ? _mm512_reduce_min_pd(_mm512_min_pd(a, b)) : _mm512_reduce_max_pd(_mm512_max_pd(a, b));
+	int mask = _mm512_cmp_pd_mask(a, _mm512_set1_pd(m), _CMP_EQ_OQ)
+			| _mm512_cmp_pd_mask(b, _mm512_set1_pd(m), _CMP_EQ_OQ) << 8;
+#endif
+	return __builtin_ctz(mask | 1 << (PQ_ARITY - 1));
+}
+
+#define SIFT_NAME	sift_down_avx512
+#define SIFT_TARGET	__attribute__((target("avx512f")))
+#define SIFT_MIN(p)	best_avx512(p, 1)
+#define SIFT_MAX(p)	best_avx512(p, 0)
+#include "pq_sift.h"
+#undef SIFT_NAME
+#undef SIFT_TARGET
+#undef SIFT_MIN
+#undef SIFT_MAX
+#endif
+
+//tracking and non-tracking entry points for each instruction set
+typedef void (*SIFT_FN)(PQ *pq, int i);
+static void sift_scalar_1(PQ *pq, int i){ sift_down_scalar(pq, i, 1); }
+static void sift_scalar_0(PQ *pq, int i){ sift_down_scalar(pq, i, 0); }
+__attribute__((target("avx2"))) static void sift_avx2_1(PQ *pq, int i){ sift_down_avx2(pq, i, 1); }
+__attribute__((target("avx2"))) static void sift_avx2_0(PQ *pq, int i){ sift_down_avx2(pq, i, 0); }
+#if PQ_ARITY >= 8
+__attribute__((target("avx512f"))) static void sift_avx512_1(PQ *pq, int i){ sift_down_avx512(pq, i, 1); }
+__attribute__((target("avx512f"))) static void sift_avx512_0(PQ *pq, int i){ sift_down_avx512(pq, i, 0); }
+#endif
+
+static SIFT_FN sift_tracked = sift_scalar_1;
+static SIFT_FN sift_untracked = sift_scalar_0;
+
+//picks the widest kernel the cpu supports, once at load time
+__attribute__((constructor)) static void pick_sift(void){
+	__builtin_cpu_init();
+#if PQ_ARITY >= 8
+	if(__builtin_cpu_supports("avx512f")){
+		sift_tracked = sift_avx512_1;
+		sift_untracked = sift_avx512_0;
+		return;
+	}
+#endif
+	if(__builtin_cpu_supports("avx2")){
+		sift_tracked = sift_avx2_1;
+		sift_untracked = sift_avx2_0;
+	}
+}
+#endif
+
+//sift-down shared by perculate_down and the bulk builders
+static inline void sift_down(PQ *pq, int i, int track){
+#ifdef PQ_SIMD
+	if(track)
+		sift_tracked(pq, i);
+	else
+		sift_untracked(pq, i);
+#else
+	sift_down_scalar(pq, i, track);
+#endif
+}
+
 void perculate_down(PQ *pq, int i){
-	
-	int left = 2 * i; //left child
-	int right = left + 1; //right child
-	int done = 0;
-	int min = left;
-	int max = left; 
-
-	//min-heap perc down
-	if(pq->type != 0){		
-		while(left <= pq->size && !done){
-			min = left;
-			//check to see if the right child is min
-			if(right <= pq->size && pq->heap[right].priority < pq->heap[left].priority)
-				min = right;
-			if(pq->heap[min].priority < pq->heap[i].priority){
-				//swap
-				int id = pq->heap[min].id;
-				double priority = pq->heap[min].priority;
-				int pos = pq->heap[min].position;
-				int id2 = pq->heap[i].id;
-				double priority2 = pq->heap[i].priority;
-				int pos2 = pq->heap[i].position;
-
-				//modify the heap 
-				pq->heap[min].id = id2;
-				pq->heap[min].priority = priority2;
-				pq->heap[min].position = pos;
-				pq->heap[i].id = id;
-				pq->heap[i].priority = priority;
-				pq->heap[i].position = pos2;
-				//modify the array 
-				pq->nodePtrs[id] = &(pq->heap[i]);
-				pq->nodePtrs[id2] = &(pq->heap[min]); 
-
-				i = min;
-			}
-			else{
-				done = 1;
-			}
-			left = 2 * i;
-			right = left + 1;
-		}	
-	}
-	// max heap perc down
-	else {	
-		while(left <= pq->size && !done){
-			max = left;
-			//check to see if the right child is max
-			if(right <= pq->size && pq->heap[right].priority > pq->heap[left].priority)
-				max = right;
-			if(pq->heap[max].priority > pq->heap[i].priority){
-				//swap
-				int id = pq->heap[min].id;
-				double priority = pq->heap[min].priority;
-				int pos = pq->heap[min].position;
-				int id2 = pq->heap[i].id;
-				double priority2 = pq->heap[i].priority;
-				int pos2 = pq->heap[i].position;
-
-				//modify the heap
-				pq->heap[min].id = id2;
-				pq->heap[min].priority = priority2;
-				pq->heap[min].position = pos;
-				pq->heap[i].id = id;
-				pq->heap[i].priority = priority;
-				pq->heap[i].position = pos2;
-				//modify the array of node pointers 
-				pq->nodePtrs[id] = &(pq->heap[i]);
-				pq->nodePtrs[id2] = &(pq->heap[min]); 
-
-				i = max;
-			}
-			else{
-				done = 1;
-			}
-			left = 2 * i;
-			right = left + 1;
-		}	
+	sift_down(pq, i, 1);
+}
+
+/* restores the heap property over prio[1..size] bottom-up (Floyd),
+ * then rewrites the pos index in one sequential pass over the heap.
+ */
+static void heapify(PQ *pq){
+	int i;
+	for(i = PARENT(pq->size); i >= 1; i--)
+		sift_down(pq, i, 0);
+	for(i = 1; i <= pq->size; i++)
+		pq->pos[pq->ids[i]] = i;
+}
+
+/* drops every tombstone: the live entries are packed to the front in
+ * their current order and heapified, O(size)
+ */
+static void compact(PQ *pq){
+	int i, n = 0;
+	for(i = 1; i <= pq->size; i++){
+		if(pq->dead[pq->ids[i]]){
+			pq->dead[pq->ids[i]] = 0;
+			pq->pos[pq->ids[i]] = 0;
+			continue;
+		}
+		n++;
+		pq->prio[n] = pq->prio[i];
+		pq->ids[n] = pq->ids[i];
 	}
+	pq->size = n;
+	pq->ndead = 0;
+	STAT(stat_begin(pq, PQ_STAT_PURGE);)
+	heapify(pq);
 }
+
 int pq_change_priority(PQ * pq, int id, double new_priority){
+	if(pq->engine != NULL)
+		return pq->engine->change_priority(pq->impl, id, new_priority);
 	//conditions for failure
-	//id not in pq
-	if(pq->nodePtrs[id] == NULL){
-		printf("ERROR: There is no such ID in PQ.\n");
-		return 0;
-	}
 	//out of range
 	if(id < 0 || pq->capacity <= id){
 		printf("ERROR:The value is out of range.\n");
 		return 0;
 	}
+	//id not in pq
+	if(pq->pos[id] == 0 || tombstone(pq, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
 	//consition for success
-	//check if there is an entry for the given id
-	if(pq->nodePtrs[id] != NULL){
-		//check if min heap
-		if(pq->type != 0){
-			//check if old priority < new 
-			if(new_priority > pq->nodePtrs[id]->priority ){
-				//change priority to new priority
-				pq->nodePtrs[id]->priority = new_priority;
-				//perc down
-				perculate_down(pq, pq->nodePtrs[id]->position);
-			}
-			else{
-				//change priority to new priority
-				pq->nodePtrs[id]->priority = new_priority;
-				//perc up
-				perculate_up(pq, pq->nodePtrs[id]->position);
-			}
+	pq->threshold = NAN;
+	int position = pq->pos[id];
+	double old_priority = pq->prio[position];
+	//change priority to new priority
+	pq->prio[position] = new_priority;
+	//check if min heap
+	if(pq->type != 0){
+		//check if old priority < new
+		if(new_priority > old_priority){
+			STAT(stat_begin(pq, PQ_STAT_CHANGE_DOWN);)
+			perculate_down(pq, position);
 		}
-		//check if max heap
-		else{
-			//check if old priority < new 
-			if(new_priority < pq->nodePtrs[id]->priority ){
-				//change priority to new priority
-				pq->nodePtrs[id]->priority = new_priority;
-				//perc down
-				perculate_down(pq, pq->nodePtrs[id]->position);
-			}
-			else{
-				//change priority to new priority
-				pq->nodePtrs[id]->priority = new_priority;
-				//perc up
-				perculate_up(pq, pq->nodePtrs[id]->position);
-			}
+		else {
+			STAT(stat_begin(pq, PQ_STAT_CHANGE_UP);)
+			perculate_up(pq, position);
+		}
+	}
+	//check if max heap
+	else{
+		//check if old priority > new
+		if(new_priority < old_priority){
+			STAT(stat_begin(pq, PQ_STAT_CHANGE_DOWN);)
+			perculate_down(pq, position);
+		}
+		else {
+			STAT(stat_begin(pq, PQ_STAT_CHANGE_UP);)
+			perculate_up(pq, position);
 		}
 	}
 	return 1;
 }
 
 int pq_remove_by_id(PQ * pq, int id){
+	if(pq->engine != NULL)
+		return pq->engine->remove_by_id(pq->impl, id);
 	//failure conditions
-	//id not in pq
-	if(pq->nodePtrs[id] == NULL){
-		printf("ERROR: There is no such ID in PQ.\n");
-		return 0;
-	}
 	//out of range
 	if(id < 0 || pq->capacity  <= id ){
 		printf("ERROR: The value is out of Range!.\n");
 		return 0;
 	}
-	
+	//id not in pq
+	if(pq->pos[id] == 0 || tombstone(pq, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+
 	//success conditions
-	//check if there is an entry with the given id
-	if(pq->nodePtrs[id] != NULL){
-		NODE *target = (pq->nodePtrs[id]);
-		NODE *replacement = &(pq->heap[pq->size]);
-		
-		int oldPriority = target->priority;		
-		int newPriority = replacement->priority;
-		int position = target->position;
-		
-		pq->heap[position].priority = replacement->priority;
-		pq->heap[position].id = replacement->id;
-		
-		pq->heap[pq->size].priority = 0;
-		pq->heap[pq->size].id = 0;
-		pq->heap[pq->size].position = 0;
-		replacement->position = position;
-		
-		//decrease the size
-		pq->size = pq->size -1;
-		//check if min heap
-		if(pq->type != 0){
-			if(oldPriority > newPriority){
-				perculate_up(pq, replacement->position);
-			}
-			if(oldPriority < newPriority){
-				perculate_down(pq, replacement->position);
-			}
-			
-		}
-		//check if max heap
-		else{
-			if(oldPriority < newPriority){
-				perculate_up(pq, replacement->position);
-			}	
-			if(oldPriority > newPriority){
-				perculate_down(pq, replacement->position);
-			}
-		}
+	STAT(stat_begin(pq, PQ_STAT_REMOVE);)
+	pq->threshold = NAN;
+	//lazy removal: the entry stays as a tombstone until it reaches the
+	//top or there are enough of them to compact
+	if(pq->dead != NULL){
+		pq->dead[id] = 1;
+		pq->ndead++;
+		if(pq->ndead > pq->max_dead * pq->size)
+			compact(pq);
+		return 1;
+	}
+	//move the last node into the hole left by the target
+	int position = pq->pos[id];
+	int last = pq->size;
+	double oldPriority = pq->prio[position];
+	double newPriority = pq->prio[last];
+
+	//decrease the size
+	pq->size = pq->size - 1;
+	//modify position
+	pq->pos[id] = 0;
+
+	//nothing to fix if the target was the last node
+	if(position == last)
+		return 1;
+
+	pq->prio[position] = newPriority;
+	pq->ids[position] = pq->ids[last];
+	pq->pos[pq->ids[position]] = position;
+
+	//check if min heap
+	if(pq->type != 0){
+		if(oldPriority > newPriority)
+			perculate_up(pq, position);
+		if(oldPriority < newPriority)
+			perculate_down(pq, position);
+	}
+	//check if max heap
+	else{
+		if(oldPriority < newPriority)
+			perculate_up(pq, position);
+		if(oldPriority > newPriority)
+			perculate_down(pq, position);
 	}
-	//modify pointer
-	pq->nodePtrs[id] = NULL;
 	return 1;
 }
 
 
+int pq_contains(PQ * pq, int id){
+	double priority;
+	if(pq->engine != NULL)
+		return pq->engine->get_priority(pq->impl, id, &priority);
+	return id >= 0 && id < pq->capacity && pq->pos[id] != 0 && !tombstone(pq, id);
+}
+
 int pq_get_priority(PQ * pq, int id, double *priority){
-	if(pq->nodePtrs[id] == NULL){
-		printf("ERROR: There is no such ID in PQ.\n");
-		return 0;
-	}
+	if(pq->engine != NULL)
+		return pq->engine->get_priority(pq->impl, id, priority);
 	//out of range
-	else if(id < 0 || pq->capacity <= id){
+	if(id < 0 || pq->capacity <= id){
 		printf("ERROR: The value is out of Range!\n");
 		return 0;
 	}
-	//check if there is an entry with the given id
-	else if(pq->nodePtrs[id] != NULL){
-		//*priority is assigned the associated priority
-		*priority = pq->nodePtrs[id]->priority;
-		return 1;
+	else if(pq->pos[id] == 0 || tombstone(pq, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	//*priority is assigned the associated priority
+	*priority = pq->prio[pq->pos[id]];
+	return 1;
+}
+
+//deletes the top of a non-empty heap: the last node takes its place and sifts down
+static void pop_top(PQ *pq){
+	pq->threshold = NAN;
+	pq->pos[pq->ids[1]] = 0;
+	pq->prio[1] = pq->prio[pq->size];
+	pq->ids[1] = pq->ids[pq->size];
+	pq->size = pq->size - 1;
+	if(pq->size > 0)
+		sift_down(pq, 1, 1);
+}
+
+//takes tombstones off the top until a live entry (or nothing) is there
+static void purge_top(PQ *pq){
+	while(pq->ndead > 0 && pq->dead[pq->ids[1]]){
+		pq->dead[pq->ids[1]] = 0;
+		pq->ndead--;
+		STAT(stat_begin(pq, PQ_STAT_PURGE);)
+		pop_top(pq);
 	}
 }
 
 int pq_delete_top(PQ * pq, int *id, double *priority){
+	if(pq->engine != NULL)
+		return pq->engine->delete_top(pq->impl, id, priority);
+	purge_top(pq);
 	if(0 >= pq->size ){
 		printf("ERROR: The heap is empty!!\n");
 		return 0;
 	}
-	else { 
+	else {
 		//set *id and *priority to the id and priority of the top of the heap
-		*priority = pq->heap[1].priority;
-		*id = pq->heap[1].id;
-		//element is deleted (remove_by_id)
-		pq_remove_by_id(pq, pq->heap[1].id);
+		*priority = pq->prio[1];
+		*id = pq->ids[1];
+		//element is deleted
+		STAT(stat_begin(pq, PQ_STAT_DELETE);)
+		pop_top(pq);
 		return 1;
-	}	
+	}
+}
+
+int pq_delete_top_k(PQ * pq, int k, int *ids, double *priorities){
+	int n = 0;
+	if(pq->engine != NULL){
+		while(n < k && pq->engine->size(pq->impl) > 0){
+			pq->engine->delete_top(pq->impl, &ids[n], &priorities[n]);
+			n++;
+		}
+		return n;
+	}
+	while(n < k && (purge_top(pq), pq->size > 0)){
+		ids[n] = pq->ids[1];
+		priorities[n] = pq->prio[1];
+		STAT(stat_begin(pq, PQ_STAT_DELETE);)
+		pop_top(pq);
+		n++;
+	}
+	return n;
+}
+
+int pq_drain_sorted(PQ * pq, int *ids, double *priorities){
+	int n, i;
+
+	if(pq->engine != NULL)
+		return pq_delete_top_k(pq, pq_size(pq), ids, priorities);
+	pq->threshold = NAN;
+	if(pq->ndead > 0)
+		compact(pq);
+	n = pq->size;
+
+	//heapsort in place: each top is swapped behind the shrinking heap,
+	//which leaves prio[1..n] ordered from bottom to top
+	while(pq->size > 1){
+		STAT(stat_begin(pq, PQ_STAT_DELETE);)
+		double x = pq->prio[1];
+		int d = pq->ids[1];
+		pq->prio[1] = pq->prio[pq->size];
+		pq->ids[1] = pq->ids[pq->size];
+		pq->prio[pq->size] = x;
+		pq->ids[pq->size] = d;
+		pq->size = pq->size - 1;
+		sift_down(pq, 1, 0);
+	}
+	pq->size = 0;
+	for(i = 0; i < n; i++){
+		ids[i] = pq->ids[n - i];
+		priorities[i] = pq->prio[n - i];
+		pq->pos[ids[i]] = 0;
+	}
+	return n;
 }
 
 int pq_peek_top(PQ * pq, int *id, double *priority){
-	if(pq->nodePtrs[*id] == NULL){
-		printf("ERROR: There is no such ID in PQ.\n");
+	if(pq->engine != NULL)
+		return pq->engine->peek_top(pq->impl, id, priority);
+	purge_top(pq);
+	if(0 >= pq->size){
+		printf("ERROR: The heap is empty!!\n");
 		return 0;
 	}
-	//out of range
-	else if(id < 0 || pq->capacity <= *id){
-		printf("ERROR: The value is out of Range!\n");
+	//the top of the heap is always at index 1
+	*id = pq->ids[1];
+	*priority = pq->prio[1];
+	return 1;
+}
+
+//only engines with both ends (pq_create_minmax) have a bottom
+int pq_peek_bottom(PQ * pq, int *id, double *priority){
+	if(pq->engine == NULL || pq->engine->peek_bottom == NULL){
+		printf("ERROR: The queue has no bottom end.\n");
+		return 0;
+	}
+	return pq->engine->peek_bottom(pq->impl, id, priority);
+}
+
+int pq_delete_bottom(PQ * pq, int *id, double *priority){
+	if(pq->engine == NULL || pq->engine->delete_bottom == NULL){
+		printf("ERROR: The queue has no bottom end.\n");
+		return 0;
+	}
+	return pq->engine->delete_bottom(pq->impl, id, priority);
+}
+
+int pq_set_lazy_remove(PQ * pq, double max_dead){
+	if(pq->engine != NULL || pq->image != NULL || pq->in_region){
+		printf("ERROR: Lazy removal needs a pq_create or pq_create_growable queue.\n");
+		return 0;
+	}
+	if(!(max_dead >= 0 && max_dead < 1)){
+		printf("ERROR: max_dead must be at least 0 and below 1.\n");
 		return 0;
 	}
-	//check if there is an entry with the given id
-	else if(pq->nodePtrs[*id] != NULL){
-		//*priority is assigned the associated priority
-		*priority = pq->nodePtrs[0]->priority;
+	//0 goes back to removing at once
+	if(max_dead == 0){
+		if(pq->ndead > 0)
+			compact(pq);
+		free(pq->dead);
+		pq->dead = NULL;
+		pq->dead_room = 0;
 		return 1;
 	}
+	if(pq->dead == NULL){
+		pq->dead = calloc(pq->capacity, 1);
+		if(pq->dead == NULL){
+			printf("ERROR: Out of memory!\n");
+			return 0;
+		}
+		pq->dead_room = pq->capacity;
+	}
+	pq->max_dead = max_dead;
+	return 1;
+}
+
+/* sifting each of n entries costs up to one move per heap level, while
+ * rebuilding costs about one sift per node. rebuild once n times the
+ * depth outweighs the whole heap.
+ */
+static int rebuild_is_cheaper(PQ *pq, int n){
+	int i, depth = 0;
+	for(i = pq->size; i > 1; i = PARENT(i))
+		depth++;
+	return (long)n * depth > pq->size;
+}
+
+/* checks that ids[0..n-1] can all be added: in range (growing the queue
+ * if it is growable), not already in pq and not repeated in the batch.
+ * on success the slots size+1..size+n are filled in input order and pos
+ * points at them; on failure pq is left untouched and 0 is returned.
+ */
+static int load_batch(PQ *pq, const int *ids, const double *priorities, int n){
+	int i, max = -1;
+	for(i = 0; i < n; i++){
+		if(ids[i] < 0){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		if(ids[i] > max)
+			max = ids[i];
+	}
+	if(max >= pq->capacity && !grow_to(pq, max)){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	//claim each id's slot; a claimed slot means a duplicate or an id
+	//already in the queue, so release what was claimed and give up
+	for(i = 0; i < n; i++){
+		if(pq->pos[ids[i]] != 0){
+			printf("ERROR: ID is already occupied at the given position.\n");
+			while(i-- > 0)
+				pq->pos[ids[i]] = 0;
+			return 0;
+		}
+		pq->pos[ids[i]] = pq->size + 1 + i;
+	}
+	memcpy(pq->prio + pq->size + 1, priorities, sizeof(double) * n);
+	memcpy(pq->ids + pq->size + 1, ids, sizeof(int) * n);
+	pq->size += n;
+	return 1;
+}
+
+/* pq_insert_bulk for engines: insert one by one, taking the batch
+ * back out again if any insert fails.
+ */
+static int engine_insert_all(PQ *pq, const int *ids, const double *priorities, int n){
+	int i;
+	for(i = 0; i < n; i++){
+		if(!pq->engine->insert(pq->impl, ids[i], priorities[i])){
+			while(i-- > 0)
+				pq->engine->remove_by_id(pq->impl, ids[i]);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//discards the contents of an array heap queue, tombstones included
+static void clear_heap(PQ *pq){
+	int i;
+	pq->threshold = NAN;
+	for(i = 1; i <= pq->size; i++){
+		pq->pos[pq->ids[i]] = 0;
+		if(pq->dead != NULL)
+			pq->dead[pq->ids[i]] = 0;
+	}
+	pq->size = 0;
+	pq->ndead = 0;
+}
+
+int pq_build(PQ * pq, const int *ids, const double *priorities, int n){
+	if(pq->engine != NULL){
+		int id;
+		double priority;
+		while(pq->engine->size(pq->impl) > 0)
+			pq->engine->delete_top(pq->impl, &id, &priority);
+		return n >= 0 && engine_insert_all(pq, ids, priorities, n);
+	}
+	clear_heap(pq);
+
+	if(n < 0 || !load_batch(pq, ids, priorities, n))
+		return 0;
+	STAT(stat_begin(pq, PQ_STAT_BULK);)
+	heapify(pq);
+	return 1;
+}
+
+/* threaded bulk build. the pairs sit in heap slots 1..n in input order
+ * and each phase splits its work between the threads:
+ *
+ *   BUILD_SCAN   copies the input into the slots (unless it is already
+ *                there) and finds the smallest and largest id
+ *   BUILD_CLAIM  points pos at each id's slot with a compare-and-swap;
+ *                a lost swap means a repeated id
+ *   BUILD_UNDO   clears the claims again after a lost swap
+ *   BUILD_SIFT   heapifies disjoint subtrees below a cut level
+ *   BUILD_POS    rewrites pos from the finished heap
+ *
+ * between BUILD_SIFT and BUILD_POS the calling thread heapifies the few
+ * levels above the cut. every node is sifted after all of its
+ * descendants and a sift stays inside the node's subtree, so the heap
+ * comes out exactly as heapify() leaves it.
+ */
+enum { BUILD_SCAN, BUILD_CLAIM, BUILD_UNDO, BUILD_SIFT, BUILD_POS };
+
+#define BUILD_MIN_SLICE		(1 << 16)	//fewer slots per thread do not pay for the thread
+#define BUILD_MAX_THREADS	256
+
+typedef struct build_job {
+	PQ *pq;
+	int phase;
+	const int *ids;				//input of BUILD_SCAN, NULL if it is in the slots
+	const double *priorities;
+	int lo;						//slots [lo, hi), subtree roots for BUILD_SIFT
+	int hi;
+	int min;					//smallest (if negative) and largest id seen by BUILD_SCAN
+	int max;
+	int clash;					//BUILD_CLAIM lost a swap
+	int started;				//runs on its own thread
+	pthread_t thread;
+} BUILD_JOB;
+
+//Floyd's heapify of the subtrees rooted at [lo, hi), bottom level first
+static void sift_subtrees(PQ *pq, int lo, int hi){
+	int first[32], last[32], depth = 0, i, inner = PARENT(pq->size);
+
+	//[first, last] are the subtrees' nodes with children on each level
+	first[0] = lo;
+	last[0] = hi - 1 < inner ? hi - 1 : inner;
+	while(first[depth] <= last[depth]){
+		first[depth + 1] = FIRST_CHILD(first[depth]);
+		last[depth + 1] = FIRST_CHILD(last[depth]) + PQ_ARITY - 1 > inner
+				? inner : FIRST_CHILD(last[depth]) + PQ_ARITY - 1;
+		depth++;
+	}
+	while(depth-- > 0)
+		for(i = last[depth]; i >= first[depth]; i--)
+			sift_down(pq, i, 0);
+}
+
+static void * build_work(void *arg){
+	BUILD_JOB *j = arg;
+	PQ *pq = j->pq;
+	int i, id, slot;
+
+	switch(j->phase){
+	case BUILD_SCAN:
+		if(j->ids != NULL){
+			memcpy(pq->ids + j->lo, j->ids + j->lo - 1, sizeof(int) * (j->hi - j->lo));
+			memcpy(pq->prio + j->lo, j->priorities + j->lo - 1, sizeof(double) * (j->hi - j->lo));
+		}
+		j->min = 0;
+		j->max = -1;
+		for(i = j->lo; i < j->hi; i++){
+			id = pq->ids[i];
+			if(id < j->min)
+				j->min = id;
+			if(id > j->max)
+				j->max = id;
+		}
+		break;
+	case BUILD_CLAIM:
+		j->clash = 0;
+		for(i = j->lo; i < j->hi; i++){
+			slot = 0;
+			if(!__atomic_compare_exchange_n(&pq->pos[pq->ids[i]], &slot, i, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				j->clash = 1;
+		}
+		break;
+	case BUILD_UNDO:
+		for(i = j->lo; i < j->hi; i++)
+			if(__atomic_load_n(&pq->pos[pq->ids[i]], __ATOMIC_RELAXED) == i)
+				__atomic_store_n(&pq->pos[pq->ids[i]], 0, __ATOMIC_RELAXED);
+		break;
+	case BUILD_SIFT:
+		sift_subtrees(pq, j->lo, j->hi);
+		break;
+	case BUILD_POS:
+		for(i = j->lo; i < j->hi; i++)
+			pq->pos[pq->ids[i]] = i;
+		break;
+	}
+	return NULL;
+}
+
+//splits [lo, hi) evenly between the jobs
+static void slice(BUILD_JOB *jobs, int threads, int lo, int hi){
+	int t;
+	for(t = 0; t < threads; t++){
+		jobs[t].lo = lo + (int)((long)(hi - lo) * t / threads);
+		jobs[t].hi = lo + (int)((long)(hi - lo) * (t + 1) / threads);
+	}
+}
+
+//runs a phase, jobs[0] on the calling thread; a job whose thread cannot start runs there too
+static void run_phase(BUILD_JOB *jobs, int threads, int phase){
+	int t;
+	for(t = 0; t < threads; t++)
+		jobs[t].phase = phase;
+	for(t = 1; t < threads; t++)
+		jobs[t].started = pthread_create(&jobs[t].thread, NULL, build_work, &jobs[t]) == 0;
+	build_work(&jobs[0]);
+	for(t = 1; t < threads; t++){
+		if(jobs[t].started)
+			pthread_join(jobs[t].thread, NULL);
+		else
+			build_work(&jobs[t]);
+	}
+}
+
+/* grow_to for a queue whose slots 1..n are filled while its size is
+ * still 0, as the builders fill them: realloc_arrays keeps only the
+ * slots up to size.
+ */
+static int grow_filled(PQ *pq, int id, int n){
+	int grown;
+	pq->size = n;
+	grown = grow_to(pq, id);
+	pq->size = 0;
+	return grown;
+}
+
+/* builds the empty queue pq from n pairs, taken from ids and priorities
+ * or (if they are NULL) already in slots 1..n, on up to threads
+ * threads. on failure pq is left empty.
+ */
+static int build_threaded(PQ *pq, const int *ids, const double *priorities, int n, int threads){
+	BUILD_JOB jobs[BUILD_MAX_THREADS];
+	int t, i, min = 0, max = -1, clash = 0, cut = 1, width = 1;
+
+	STAT(threads = 1;)	//the counters are not atomic
+	if(threads > n / BUILD_MIN_SLICE)
+		threads = n / BUILD_MIN_SLICE;
+	if(threads > BUILD_MAX_THREADS)
+		threads = BUILD_MAX_THREADS;
+	if(threads < 1)
+		threads = 1;
+	for(t = 0; t < threads; t++){
+		jobs[t].pq = pq;
+		jobs[t].ids = ids;
+		jobs[t].priorities = priorities;
+	}
+
+	slice(jobs, threads, 1, n + 1);
+	run_phase(jobs, threads, BUILD_SCAN);
+	for(t = 0; t < threads; t++){
+		if(jobs[t].min < min)
+			min = jobs[t].min;
+		if(jobs[t].max > max)
+			max = jobs[t].max;
+	}
+	if(min < 0 || (max >= pq->capacity && !grow_filled(pq, max, n))){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	run_phase(jobs, threads, BUILD_CLAIM);
+	for(t = 0; t < threads; t++)
+		clash |= jobs[t].clash;
+	if(clash){
+		run_phase(jobs, threads, BUILD_UNDO);
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+
+	pq->size = n;
+	STAT(stat_begin(pq, PQ_STAT_BULK);)
+	if(threads == 1){
+		heapify(pq);
+		return 1;
+	}
+	//cut at the first level with a few subtrees per thread
+	while(width < 4 * threads && cut <= PARENT(n)){
+		cut = FIRST_CHILD(cut);
+		width *= PQ_ARITY;
+	}
+	slice(jobs, threads, cut, width <= n - cut ? cut + width : n + 1);
+	run_phase(jobs, threads, BUILD_SIFT);
+	for(i = cut - 1; i >= 1; i--)
+		sift_down(pq, i, 0);
+	slice(jobs, threads, 1, n + 1);
+	run_phase(jobs, threads, BUILD_POS);
+	return 1;
+}
+
+int pq_build_parallel(PQ * pq, const int *ids, const double *priorities, int n, int threads){
+	if(pq->engine != NULL || threads <= 1)
+		return pq_build(pq, ids, priorities, n);
+	clear_heap(pq);
+	//n distinct ids need n slots
+	if(n < 0 || (n > pq->capacity && !grow_to(pq, n - 1))){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	return build_threaded(pq, ids, priorities, n, threads);
+}
+
+int pq_build_stream(PQ * pq, int (*next)(void *ctx, int *id, double *priority), void *ctx, int threads){
+	int n = 0, id;
+	double priority;
+
+	if(pq->engine != NULL){
+		pq_build(pq, NULL, NULL, 0);
+		while(next(ctx, &id, &priority)){
+			if(!pq->engine->insert(pq->impl, id, priority)){
+				pq_build(pq, NULL, NULL, 0);
+				return 0;
+			}
+		}
+		return 1;
+	}
+	clear_heap(pq);
+	//read straight into the heap slots, the only serial part
+	while(next(ctx, &id, &priority)){
+		if(n == pq->capacity && !grow_filled(pq, pq->capacity, n)){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		n++;
+		pq->ids[n] = id;
+		pq->prio[n] = priority;
+	}
+	return build_threaded(pq, NULL, NULL, n, threads);
+}
+
+int pq_insert_bulk(PQ * pq, const int *ids, const double *priorities, int n){
+	int old, i;
+
+	if(pq->engine != NULL)
+		return n >= 0 && engine_insert_all(pq, ids, priorities, n);
+	//tombstoned ids must be insertable again
+	if(pq->ndead > 0)
+		compact(pq);
+	old = pq->size;
+	if(n < 0 || !load_batch(pq, ids, priorities, n))
+		return 0;
+	STAT(stat_begin(pq, PQ_STAT_BULK);)
+	pq->threshold = NAN;
+	if(rebuild_is_cheaper(pq, n))
+		heapify(pq);
+	else
+		for(i = old + 1; i <= pq->size; i++)
+			perculate_up(pq, i);
+	return 1;
+}
+
+/* pq_offer for candidates the threshold did not turn away: the queue is
+ * not full yet, the threshold is stale, or the candidate beats it.
+ * returns 1 if the candidate was taken.
+ */
+static int offer_slow(PQ *pq, int id, double priority){
+	int i;
+	if(pq->k == 0){
+		printf("ERROR: The queue has no top-K bound.\n");
+		return 0;
+	}
+	if(id < 0 || pq->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	//tombstones would count towards k
+	if(pq->ndead > 0)
+		compact(pq);
+	if((i = pq->pos[id]) != 0){
+		//kept already: only a better score moves it, away from the top
+		if(pq->type != 0 ? !(priority > pq->prio[i]) : !(priority < pq->prio[i]))
+			return 0;
+		STAT(stat_begin(pq, PQ_STAT_CHANGE_DOWN);)
+		pq->prio[i] = priority;
+		sift_down(pq, i, 1);
+	}
+	else if(pq->size < pq->k){
+		STAT(stat_begin(pq, PQ_STAT_INSERT);)
+		pq->size = pq->size + 1;
+		pq->prio[pq->size] = priority;
+		pq->ids[pq->size] = id;
+		pq->pos[id] = pq->size;
+		perculate_up(pq, pq->size);
+	}
+	else if(pq->type != 0 ? priority > pq->prio[1] : priority < pq->prio[1]){
+		//the candidate takes the evicted top's slot: one sift instead of
+		//the two of pq_delete_top and pq_insert
+		STAT(stat_begin(pq, PQ_STAT_DELETE);)
+		pq->pos[pq->ids[1]] = 0;
+		pq->prio[1] = priority;
+		pq->ids[1] = id;
+		sift_down(pq, 1, 1);
+	}
+	else
+		i = -1;
+	pq->threshold = pq->size >= pq->k ? pq->prio[1] : NAN;
+	return i >= 0;
+}
+
+int pq_offer(PQ * pq, int id, double priority){
+	//nothing compares true against NAN, so only a full queue with a
+	//current threshold turns candidates away here
+	if(pq->type != 0 ? priority <= pq->threshold : priority >= pq->threshold)
+		return 0;
+	return offer_slow(pq, id, priority);
+}
+
+int pq_offer_bulk(PQ * pq, const int *ids, const double *priorities, int n){
+	int i, taken = 0;
+	double t = pq->threshold;
+
+	//one loop per heap type keeps the rejection a single compare
+	if(pq->type != 0){
+		for(i = 0; i < n; i++){
+			if(priorities[i] <= t)
+				continue;
+			taken += offer_slow(pq, ids[i], priorities[i]);
+			t = pq->threshold;
+		}
+	}
+	else {
+		for(i = 0; i < n; i++){
+			if(priorities[i] >= t)
+				continue;
+			taken += offer_slow(pq, ids[i], priorities[i]);
+			t = pq->threshold;
+		}
+	}
+	return taken;
+}
+
+int pq_change_priorities(PQ * pq, const int *ids, const double *new_priorities, int n){
+	int i, changed = 0;
+
+	//a few changes (or no array heap): sift each one into place
+	if(pq->engine != NULL || !rebuild_is_cheaper(pq, n)){
+		for(i = 0; i < n; i++)
+			changed += pq_change_priority(pq, ids[i], new_priorities[i]);
+		return changed;
+	}
+	//a large share of the heap changes: overwrite in place, rebuild once
+	pq->threshold = NAN;
+	for(i = 0; i < n; i++){
+		if(ids[i] < 0 || pq->capacity <= ids[i] || pq->pos[ids[i]] == 0 || tombstone(pq, ids[i])){
+			printf("ERROR: There is no such ID in PQ.\n");
+			continue;
+		}
+		pq->prio[pq->pos[ids[i]]] = new_priorities[i];
+		changed++;
+	}
+	STAT(stat_begin(pq, PQ_STAT_BULK);)
+	heapify(pq);
+	return changed;
+}
+
+/* moves the entries of src whose id pick accepts (all of them if pick
+ * is NULL) to the end of dst's arrays and re-heapifies both. every id
+ * is checked against dst before anything moves; returns 0 on a clash.
+ */
+static int move_entries(PQ *dst, PQ *src, int (*pick)(int id, void *ctx), void *ctx){
+	int i, id, old, n = 0, left = 0, max = -1;
+
+	//tombstones would clash with live ids and must not move
+	if(dst->ndead > 0)
+		compact(dst);
+	if(src->ndead > 0)
+		compact(src);
+	for(i = 1; i <= src->size; i++){
+		id = src->ids[i];
+		if(pick != NULL && !pick(id, ctx))
+			continue;
+		if(id >= dst->capacity && (!dst->growable || PQ_MAX_CAPACITY <= id)){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		if(id < dst->capacity && dst->pos[id] != 0){
+			printf("ERROR: ID is already occupied at the given position.\n");
+			return 0;
+		}
+		if(id > max)
+			max = id;
+		n++;
+	}
+	if(max >= dst->capacity && !grow_to(dst, max)){
+		printf("ERROR: Out of memory!\n");
+		return 0;
+	}
+	if(n == 0)
+		return 1;
+
+	//one pass: picked entries are appended to dst, the rest close up in src
+	old = dst->size;
+	for(i = 1; i <= src->size; i++){
+		id = src->ids[i];
+		if(n == src->size || pick == NULL || pick(id, ctx)){
+			dst->size = dst->size + 1;
+			dst->prio[dst->size] = src->prio[i];
+			dst->ids[dst->size] = id;
+			dst->pos[id] = dst->size;
+			src->pos[id] = 0;
+		}
+		else {
+			left++;
+			src->prio[left] = src->prio[i];
+			src->ids[left] = id;
+		}
+	}
+	src->size = left;
+	src->threshold = NAN;
+	dst->threshold = NAN;
+	STAT(stat_begin(src, PQ_STAT_BULK);)
+	heapify(src);
+	STAT(stat_begin(dst, PQ_STAT_BULK);)
+	if(rebuild_is_cheaper(dst, n))
+		heapify(dst);
+	else
+		for(i = old + 1; i <= dst->size; i++)
+			perculate_up(dst, i);
+	return 1;
+}
+
+//shared checks of pq_merge and pq_split
+static int can_move(PQ *dst, PQ *src){
+	if(dst == src){
+		printf("ERROR: A queue cannot be merged with itself.\n");
+		return 0;
+	}
+	if((dst->type != 0) != (src->type != 0)){
+		printf("ERROR: Both queues must be min-heaps or both max-heaps.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_merge(PQ * dst, PQ * src){
+	if(!can_move(dst, src))
+		return 0;
+	//engines meld their own kind
+	if(dst->engine != NULL && dst->engine == src->engine && dst->engine->merge != NULL)
+		return dst->engine->merge(dst->impl, src->impl);
+	if(dst->engine != NULL || src->engine != NULL){
+		printf("ERROR: These queues cannot be merged.\n");
+		return 0;
+	}
+	return move_entries(dst, src, NULL, NULL);
+}
+
+int pq_split(PQ * src, PQ * dst, int (*pick)(int id, void *ctx), void *ctx){
+	if(!can_move(dst, src))
+		return 0;
+	if(dst->engine != NULL || src->engine != NULL){
+		printf("ERROR: These queues cannot be merged.\n");
+		return 0;
+	}
+	return move_entries(dst, src, pick, ctx);
+}
+
+int pq_stats(PQ * pq, PQ_COUNTERS *stats){
+#ifdef PQ_STATS
+	if(pq->engine == NULL){
+		*stats = pq->stats;
+		return 1;
+	}
+#endif
+	(void)pq;
+	memset(stats, 0, sizeof(PQ_COUNTERS));
+	return 0;
+}
+
+void pq_stats_reset(PQ * pq){
+#ifdef PQ_STATS
+	if(pq->engine == NULL)
+		memset(&pq->stats, 0, sizeof(pq->stats));
+#endif
+	(void)pq;
+}
+
+
+/* queue images. an image is one region holding a header and the three
+ * heap arrays at fixed offsets from its start:
+ *
+ *   0         PQ_IMAGE header, padded to a cache line
+ *   prio_off  PRIO_LEAD + capacity + 1 doubles (prio as in memory)
+ *   ids_off   capacity + 1 ints
+ *   pos_off   capacity ints
+ *
+ * every section starts on a cache line. the arrays hold heap indices
+ * and ids only, never addresses, so the region can be saved to a file,
+ * mapped back at any address, or shared between processes.
+ */
+#define PQ_IMAGE_MAGIC		"PQIMAGE"
+#define PQ_IMAGE_VERSION	1
+#define PQ_IMAGE_ORDER		0x01020304u	//reads back differently on the other byte order
+
+typedef struct pq_image {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t arity;		//heap order depends on PQ_ARITY
+	uint32_t min_heap;
+	uint32_t capacity;
+	uint32_t size;		//as of the last pq_save or pq_sync
+	uint64_t prio_off;
+	uint64_t ids_off;
+	uint64_t pos_off;
+	uint64_t total;		//length of the whole image
+} PQ_IMAGE;
+
+static uint64_t line_up(uint64_t n){
+	return (n + PQ_CACHE_LINE - 1) / PQ_CACHE_LINE * PQ_CACHE_LINE;
+}
+
+//header of an image for the given queue shape, with the section offsets filled in
+static void image_layout(PQ_IMAGE *h, int capacity, int min_heap){
+	memset(h, 0, sizeof(PQ_IMAGE));
+	memcpy(h->magic, PQ_IMAGE_MAGIC, sizeof(h->magic));
+	h->version = PQ_IMAGE_VERSION;
+	h->byte_order = PQ_IMAGE_ORDER;
+	h->arity = PQ_ARITY;
+	h->min_heap = min_heap != 0;
+	h->capacity = capacity;
+	h->prio_off = line_up(sizeof(PQ_IMAGE));
+	h->ids_off = line_up(h->prio_off + sizeof(double) * ((uint64_t)capacity + 1 + PRIO_LEAD));
+	h->pos_off = line_up(h->ids_off + sizeof(int) * ((uint64_t)capacity + 1));
+	h->total = line_up(h->pos_off + sizeof(int) * (uint64_t)capacity);
+}
+
+//1 if the header at the start of an image of len bytes is one this build can use
+static int image_valid(const PQ_IMAGE *h, size_t len){
+	PQ_IMAGE want;
+	if(len < sizeof(PQ_IMAGE) || memcmp(h->magic, PQ_IMAGE_MAGIC, sizeof(h->magic)) != 0
+			|| h->version != PQ_IMAGE_VERSION || h->byte_order != PQ_IMAGE_ORDER
+			|| h->arity != PQ_ARITY || h->capacity == 0 || h->capacity > PQ_MAX_CAPACITY)
+		return 0;
+	image_layout(&want, h->capacity, h->min_heap);
+	return h->prio_off == want.prio_off && h->ids_off == want.ids_off && h->pos_off == want.pos_off
+		&& h->total == want.total && h->total <= len && h->size <= h->capacity;
+}
+
+//points p's arrays at the sections of the image starting at h
+static void use_image(PQ *p, PQ_IMAGE *h){
+	p->prio = (double *)((char *)h + h->prio_off) + PRIO_LEAD;
+	p->ids = (int *)((char *)h + h->ids_off);
+	p->pos = (int *)((char *)h + h->pos_off);
+	p->ids[0] = -1;
+	p->prio[0] = -1;
+	p->capacity = h->capacity;
+	p->size = h->size;
+	p->type = h->min_heap;
+	p->growable = 0;
+	p->k = 0;
+	p->threshold = NAN;
+	p->dead = NULL;
+	p->ndead = 0;
+	p->engine = NULL;
+	p->in_region = 0;
+	STAT(memset(&p->stats, 0, sizeof(p->stats));)
+}
+
+//a queue over the image mapped at base
+static PQ * image_attach(void *base, size_t len, int shared){
+	PQ *p = malloc(sizeof(PQ));
+	use_image(p, base);
+	p->mem = base;
+	p->map_len = len;
+	p->image = base;
+	p->shared = shared;
+	return p;
+}
+
+int pq_save(PQ * pq, const char *path){
+	PQ_IMAGE h;
+	FILE *f;
+	char *tmp;
+	int ok;
+
+	if(pq->engine != NULL){
+		printf("ERROR: Only array heap queues can be saved.\n");
+		return 0;
+	}
+	//image_valid would refuse the image (pq_create takes any capacity)
+	if(pq->capacity > PQ_MAX_CAPACITY){
+		printf("ERROR: Capacity is out of Range!\n");
+		return 0;
+	}
+	//tombstones are not part of the image
+	if(pq->ndead > 0)
+		compact(pq);
+	image_layout(&h, pq->capacity, pq->type);
+	h.size = pq->size;
+
+	//write next to the target and rename, so a crash never leaves half an image
+	tmp = malloc(strlen(path) + 5);
+	sprintf(tmp, "%s.tmp", path);
+	f = fopen(tmp, "wb");
+	if(f == NULL){
+		printf("ERROR: Cannot write %s\n", tmp);
+		free(tmp);
+		return 0;
+	}
+	ok = fwrite(&h, sizeof(h), 1, f) == 1
+		&& fseek(f, h.prio_off, SEEK_SET) == 0
+		&& fwrite(pq->prio - PRIO_LEAD, sizeof(double), (size_t)pq->size + 1 + PRIO_LEAD, f) == (size_t)pq->size + 1 + PRIO_LEAD
+		&& fseek(f, h.ids_off, SEEK_SET) == 0
+		&& fwrite(pq->ids, sizeof(int), (size_t)pq->size + 1, f) == (size_t)pq->size + 1
+		&& fseek(f, h.pos_off, SEEK_SET) == 0
+		&& fwrite(pq->pos, sizeof(int), pq->capacity, f) == (size_t)pq->capacity
+		&& fflush(f) == 0 && ftruncate(fileno(f), h.total) == 0 && fsync(fileno(f)) == 0;
+	ok = fclose(f) == 0 && ok && rename(tmp, path) == 0;
+	if(!ok){
+		printf("ERROR: Cannot write %s\n", tmp);
+		remove(tmp);
+	}
+	free(tmp);
+	return ok;
+}
+
+/* maps an image from fd. shared mappings write through to the file or
+ * segment; private ones are copy-on-write, so the queue can still be
+ * changed without touching the file.
+ */
+static PQ * image_map(int fd, int shared, const char *name){
+	struct stat st;
+	void *base;
+
+	if(fstat(fd, &st) != 0){
+		printf("ERROR: Cannot open %s\n", name);
+		return NULL;
+	}
+	base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	if(st.st_size == 0 || base == MAP_FAILED){
+		printf("ERROR: Cannot map %s\n", name);
+		return NULL;
+	}
+	if(!image_valid(base, st.st_size)){
+		printf("ERROR: %s is not a queue image for this build.\n", name);
+		munmap(base, st.st_size);
+		return NULL;
+	}
+	return image_attach(base, st.st_size, shared);
+}
+
+PQ * pq_open_mapped(const char *path, int writable){
+	int fd = open(path, writable ? O_RDWR : O_RDONLY);
+	PQ *p;
+	if(fd < 0){
+		printf("ERROR: Cannot open %s\n", path);
+		return NULL;
+	}
+	p = image_map(fd, writable, path);
+	close(fd);
+	return p;
+}
+
+PQ * pq_open_shm(const char *name, int capacity, int min_heap){
+	PQ_IMAGE h;
+	PQ *p;
+	int fd;
+
+	//the first process creates and sizes the segment, the rest attach
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd >= 0){
+		if(0 >= capacity || PQ_MAX_CAPACITY < capacity){
+			printf("Capacity must be between 1 and %d!\n", PQ_MAX_CAPACITY);
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+		image_layout(&h, capacity, min_heap);
+		if(ftruncate(fd, h.total) != 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)){
+			printf("ERROR: Cannot size shared memory %s\n", name);
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+	}
+	else if((fd = shm_open(name, O_RDWR, 0600)) < 0){
+		printf("ERROR: Cannot open shared memory %s\n", name);
+		return NULL;
+	}
+	p = image_map(fd, 1, name);
+	close(fd);
+	return p;
+}
+
+int pq_sync(PQ * pq){
+	if(pq->image == NULL)
+		return 1;
+	pq->image->size = pq->size;
+	if(pq->shared && msync(pq->mem, pq->map_len, MS_SYNC) != 0){
+		printf("ERROR: Cannot sync the queue image.\n");
+		return 0;
+	}
+	return 1;
+}
+
+
+/* single-region queues (pq_create_in). the region is the PQ struct,
+ * padded to a cache line, followed by an image laid out as above:
+ * every byte the queue uses, in one block the caller can place.
+ */
+size_t pq_footprint(int capacity){
+	PQ_IMAGE h;
+	if(0 >= capacity || PQ_MAX_CAPACITY < capacity)
+		return 0;
+	image_layout(&h, capacity, 1);
+	return line_up(sizeof(PQ)) + h.total;
+}
+
+static void unmap_region(void *mem, size_t bytes, void *ctx){
+	(void)ctx;
+	munmap(mem, bytes);
+}
+
+/* anonymous mapping of at least *len bytes, rounded up to the page size
+ * asked for. if no huge pages of that size are reserved, falls back to
+ * normal pages and asks for transparent huge pages instead. with
+ * numa_node >= 0 the pages are bound to that node before first use.
+ */
+static void * map_region(size_t *len, int pages, int numa_node){
+	size_t page = sysconf(_SC_PAGESIZE);
+	void *mem = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if(pages != PQ_PAGES_DEFAULT){
+		size_t huge = pages == PQ_PAGES_1G ? (size_t)1 << 30 : (size_t)1 << 21;
+		size_t huge_len = (*len + huge - 1) / huge * huge;
+		mem = mmap(NULL, huge_len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ((pages == PQ_PAGES_1G ? 30 : 21) << MAP_HUGE_SHIFT), -1, 0);
+		if(mem != MAP_FAILED)
+			*len = huge_len;
+	}
+#endif
+	if(mem == MAP_FAILED){
+		*len = (*len + page - 1) / page * page;
+		mem = mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(mem == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		if(pages != PQ_PAGES_DEFAULT)
+			madvise(mem, *len, MADV_HUGEPAGE);
+#endif
+	}
+	if(numa_node >= 0){
+		unsigned long mask[16] = { 0 };
+		int bits = 8 * sizeof(unsigned long);
+		if(numa_node >= 16 * bits){
+			munmap(mem, *len);
+			return NULL;
+		}
+		mask[numa_node / bits] |= 1UL << numa_node % bits;
+		//maxnode counts one past the highest node bit
+		if(syscall(SYS_mbind, mem, *len, MPOL_BIND, mask, (unsigned long)numa_node + 2, 0) != 0){
+			munmap(mem, *len);
+			return NULL;
+		}
+	}
+	return mem;
+}
+
+PQ * pq_create_in(int capacity, int min_heap, const PQ_REGION *region){
+	size_t len = pq_footprint(capacity);
+	void *mem;
+	PQ *p;
+	PQ_IMAGE *h;
+
+	if(len == 0){
+		printf("Capacity must be between 1 and %d!\n", PQ_MAX_CAPACITY);
+		return NULL;
+	}
+	if(region != NULL && region->buffer != NULL){
+		if(region->length < len || (uintptr_t)region->buffer % PQ_CACHE_LINE != 0){
+			printf("ERROR: Buffer must be %zu bytes, aligned to %d.\n", len, PQ_CACHE_LINE);
+			return NULL;
+		}
+		mem = region->buffer;
+		len = region->length;
+	}
+	else if(region != NULL && region->alloc != NULL){
+		mem = region->alloc(len, region->ctx);
+		if(mem != NULL && (uintptr_t)mem % PQ_CACHE_LINE != 0){
+			printf("ERROR: Allocator must return memory aligned to %d.\n", PQ_CACHE_LINE);
+			if(region->release != NULL)
+				region->release(mem, len, region->ctx);
+			return NULL;
+		}
+	}
+	else
+		mem = map_region(&len, region != NULL ? region->pages : PQ_PAGES_DEFAULT,
+				region != NULL ? region->numa_node - PQ_NUMA_NODE(0) : -1);	//PQ_NUMA_NONE becomes -1
+	if(mem == NULL){
+		printf("ERROR: Out of memory!\n");
+		return NULL;
+	}
+
+	//caller memory may hold anything; the header and pos must start clean
+	h = (PQ_IMAGE *)((char *)mem + line_up(sizeof(PQ)));
+	image_layout(h, capacity, min_heap);
+	p = mem;
+	use_image(p, h);
+	if(region != NULL && (region->buffer != NULL || region->alloc != NULL))
+		memset(p->pos, 0, sizeof(int) * capacity);
+	p->mem = mem;
+	p->map_len = len;
+	p->image = NULL;
+	p->in_region = 1;
+	if(region != NULL && region->buffer != NULL)
+		p->release = NULL;
+	else if(region != NULL && region->alloc != NULL)
+		p->release = region->release;
+	else
+		p->release = unmap_region;
+	p->release_ctx = region != NULL ? region->ctx : NULL;
+	return p;
 }
@@ -0,0 +1,782 @@
+#ifndef PQ_H
+#define PQ_H
+
+#include <stddef.h>
+
+/**
+* General description:  priority queue which stores pairs
+*   <id, priority>.  Top of queue is determined by priority
+*   (min or max depending on configuration).
+*
+*   There can be only one (or zero) entry for a particular id.
+*
+*   Capacity is set on creation; growable queues (pq_create_growable)
+*   extend it on demand.
+*
+*   IDs are integers in the range [0..N-1] where N is the capacity
+*   of the priority queue.  Any values outside this range are not
+*   valid IDs.
+**/
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// "Opaque type" -- definition of pq_struct hidden in pq.c
+typedef struct pq_struct PQ;
+
+
+/**
+* Function: pq_create
+* Parameters: capacity - self-explanatory
+*             min_heap - if 1 (really non-zero), then it is a min-heap
+*                        if 0, then a max-heap
+*
+* Returns:  Pointer to empty priority queue with given capacity and
+*           min/max behavior as specified.
+*
+*/
+extern PQ * pq_create(int capacity, int min_heap);
+
+/**
+* Function: pq_create_growable
+* Parameters: capacity - initial capacity
+*             min_heap - as in pq_create
+*
+* Returns:  Pointer to empty priority queue whose capacity grows
+*           automatically when an id >= capacity is inserted (up to
+*           PQ_MAX_CAPACITY).
+*
+* Desc: storage is reserved as address space up front and only backed
+*       by memory as it is touched, so growing never copies the heap.
+*
+*/
+extern PQ * pq_create_growable(int capacity, int min_heap);
+
+/**
+* Function: pq_create_pairing
+* Parameters: capacity, min_heap - as in pq_create
+*
+* Returns:  Pointer to empty priority queue backed by a pairing heap
+*           instead of the array heap.
+*
+* Desc: same interface and id semantics as pq_create.  Improving an
+*       entry's priority (decrease-key on a min-heap) is O(1); the
+*       other updates and pq_delete_top are O(log n) amortized.
+*       pq_get_priority stays O(1).
+*
+*/
+extern PQ * pq_create_pairing(int capacity, int min_heap);
+
+/**
+* Function: pq_create_radix
+* Parameters: capacity, min_heap - as in pq_create
+*
+* Returns:  Pointer to empty monotone priority queue backed by a
+*           radix heap.
+*
+* Desc: for workloads where the priorities coming off the top never
+*       go backwards (Dijkstra, event simulation clocks).  Inserting,
+*       or changing a priority to, a value before the last priority
+*       taken off the top (below it for a min-heap, above it for a
+*       max-heap) fails and returns 0.  The limit goes away whenever
+*       the queue becomes empty, so a drained queue (or one pq_build
+*       empties first) takes any priority again.  Everything else
+*       behaves as in pq_create; pq_peek_top does not move the limit.
+*       insert, change_priority and remove_by_id are O(1);
+*       delete_top is O(1) amortized over the 64 bucket levels.
+*
+*/
+extern PQ * pq_create_radix(int capacity, int min_heap);
+
+/**
+* Function: pq_create_wheel
+* Parameters: capacity, min_heap - as in pq_create
+*             tick - width of one wheel slot, in priority units
+*                    (e.g. 0.001 for timeouts given in seconds)
+*
+* Returns:  Pointer to empty priority queue backed by a hierarchical
+*           timing wheel.
+*
+* Desc: for timeouts: entries inserted at "now + delta" and mostly
+*       removed (cancelled) or changed (rescheduled) before they come
+*       off the top.  insert, change_priority and remove_by_id are
+*       O(1); delete_top and peek_top are O(1) amortized plus a scan of
+*       the entries that fall in the same tick as the top.  The order
+*       is exact, as in pq_create; pick a tick that keeps few entries
+*       per slot.  An entry put before the tick of the last top seen
+*       by peek_top or delete_top makes the next of those calls O(n),
+*       so the wheel suits priorities that mostly move forward.
+*
+*/
+extern PQ * pq_create_wheel(int capacity, int min_heap, double tick);
+
+/**
+* Function: pq_create_bucket
+* Parameters: capacity, min_heap - as in pq_create
+*             lo, hi - every priority must be a whole number in [lo, hi];
+*                      the range may hold at most 2^26 values
+*
+* Returns:  Pointer to empty priority queue backed by a bucket queue.
+*
+* Desc: one bucket per priority value, found through a bitmap, so no
+*       priorities are ever compared.  insert, change_priority,
+*       remove_by_id, delete_top and peek_top are O(1) (at most five
+*       bit scans to find the top).  Inserting or changing to a
+*       priority outside the range, or one that is not a whole number,
+*       fails and returns 0.  Uses O(hi - lo) memory on top of the
+*       per-id nodes.
+*
+*/
+extern PQ * pq_create_bucket(int capacity, int min_heap, int lo, int hi);
+
+/**
+* Function: pq_create_minmax
+* Parameters: capacity, min_heap - as in pq_create
+*
+* Returns:  Pointer to empty double-ended priority queue backed by a
+*           min-max heap.
+*
+* Desc: behaves as pq_create and also has a bottom end, the entry
+*       farthest from the top (the max of a min-heap, the min of a
+*       max-heap), for pq_peek_bottom and pq_delete_bottom.  Both
+*       peeks are O(1); insert, change_priority, remove_by_id and both
+*       deletes are O(log n).  One entry per id serves both ends.
+*
+*/
+extern PQ * pq_create_minmax(int capacity, int min_heap);
+
+/**
+* Function: pq_create_topk
+* Parameters: capacity, min_heap - as in pq_create
+*             k - most entries kept, 1 <= k <= capacity
+*
+* Returns:  Pointer to empty priority queue for pq_offer that keeps the
+*           k best candidates offered to it.
+*
+* Desc: the top is the weakest entry kept, so a min-heap keeps the k
+*       largest priorities and a max-heap the k smallest.  While the
+*       queue is full its top is cached as the threshold a candidate
+*       must beat.  Every other call works as for pq_create (and
+*       drops the cached threshold until the next pq_offer).
+*
+*/
+extern PQ * pq_create_topk(int capacity, int min_heap, int k);
+
+// key encodings for pq_create_compact
+enum { PQ_KEY_FLOAT32, PQ_KEY_UINT32 };
+
+/**
+* Function: pq_create_compact
+* Parameters: capacity, min_heap - as in pq_create
+*             key_type - PQ_KEY_FLOAT32: priorities are rounded to float
+*                        PQ_KEY_UINT32: priorities must be whole numbers
+*                                       in [0, 2^32)
+*
+* Returns:  Pointer to empty priority queue that stores each entry as
+*           one 64-bit key (32-bit priority, 32-bit id).
+*
+* Desc: uses 12 bytes per entry instead of 16, and heap comparisons
+*       are single integer compares.  pq_get_priority and the top
+*       functions return the stored (possibly rounded) priority.
+*       With PQ_KEY_UINT32, inserting or changing to a priority that
+*       does not fit fails and returns 0.  Equal priorities come off
+*       the top in increasing id order.
+*       Same runtimes as pq_create.
+*
+*/
+extern PQ * pq_create_compact(int capacity, int min_heap, int key_type);
+
+/**
+* Function: pq_create_concurrent
+* Parameters: capacity, min_heap - as in pq_create
+*
+* Returns:  Pointer to empty priority queue that may be used from
+*           several threads at once (except pq_free).
+*
+* Desc: strictly ordered, like pq_create.  Operations are applied by
+*       flat combining: each thread publishes its call and one thread
+*       at a time applies every published call to an array heap as a
+*       batch, matching a delete_top with a pending insert that beats
+*       the top without touching the heap.
+*
+*/
+extern PQ * pq_create_concurrent(int capacity, int min_heap);
+
+/**
+* Function: pq_create_multiqueue
+* Parameters: capacity, min_heap - as in pq_create
+*             nqueues - number of sub-queues; use a small multiple
+*                       (2 to 4) of the number of threads
+*
+* Returns:  Pointer to empty, relaxed priority queue that may be used
+*           from several threads at once (except pq_free).
+*
+* Desc: entries are spread over nqueues independently locked heaps.
+*       pq_delete_top and pq_peek_top return an entry near the top:
+*       the expected number of better entries still in the queue is
+*       O(nqueues), and O(nqueues log nqueues) with high probability,
+*       regardless of the queue size.  The id based calls are exact.
+*
+*/
+extern PQ * pq_create_multiqueue(int capacity, int min_heap, int nqueues);
+
+/**
+* Function: pq_reserve
+* Parameters: priority queue pq
+*             capacity - requested capacity
+* Returns: 1 on success; 0 on failure
+* Desc: makes sure ids [0..capacity-1] are valid.  On a growable queue
+*       the pages for the new range are faulted in here rather than on
+*       the insert path.  On a fixed queue the storage is reallocated.
+*       Never shrinks the queue.
+*
+*/
+extern int pq_reserve(PQ * pq, int capacity);
+
+/**
+* Function: pq_save
+* Parameters: priority queue pq (array heap queues with a capacity of
+*             at most PQ_MAX_CAPACITY only)
+*             path - file to write
+* Returns: 1 on success; 0 on failure
+* Desc: writes pq as a queue image: a versioned header followed by the
+*       priority, id and position arrays at fixed offsets.  The arrays
+*       hold indices, never addresses, so pq_open_mapped can use the
+*       file in place.  The file is written under path.tmp and renamed,
+*       so path always holds a complete image.
+* Runtime:  O(capacity)
+*
+*/
+extern int pq_save(PQ * pq, const char *path);
+
+/**
+* Function: pq_open_mapped
+* Parameters: path - image written by pq_save
+*             writable - if non-zero, changes to the queue are written
+*                        back to the file (see pq_sync); if 0 the file
+*                        is left as is (the mapping is copy-on-write)
+* Returns:  Pointer to the queue stored in the image, or NULL if the
+*           file cannot be opened or is not an image for this build
+*           (version, byte order and PQ_ARITY must match).
+* Desc: the file is mapped, not read, so even a large queue is usable
+*       at once and pages are loaded as the heap touches them.  The
+*       contents are trusted: only the header is checked.  The
+*       capacity is fixed; pq_free unmaps the file.
+* Runtime:  O(1)
+*
+*/
+extern PQ * pq_open_mapped(const char *path, int writable);
+
+/**
+* Function: pq_open_shm
+* Parameters: name - POSIX shared memory object name ("/name")
+*             capacity, min_heap - as in pq_create; only used if the
+*                                  segment does not exist yet
+* Returns:  Pointer to a queue whose image lives in the shared memory
+*           segment, or NULL on failure.
+* Desc: the first caller creates the segment and an empty queue; later
+*       callers, in any process, attach to the same image.  Processes
+*       must take turns (the queue is not thread-safe): hand over with
+*       pq_sync or pq_free, and attach again after another process
+*       had its turn, since each handle keeps its own copy of the size.
+*       Remove the segment with shm_unlink(name).
+* Runtime:  O(1)
+*
+*/
+extern PQ * pq_open_shm(const char *name, int capacity, int min_heap);
+
+/**
+* Function: pq_sync
+* Parameters: priority queue pq
+* Returns: 1 on success; 0 on failure
+* Desc: for a queue opened with pq_open_mapped (writable) or
+*       pq_open_shm, records the current size in the image header and
+*       flushes the mapping to its file.  pq_free does this too.  For
+*       other queues it does nothing.
+*
+*/
+extern int pq_sync(PQ * pq);
+
+// page sizes for the mapping pq_create_in makes itself
+enum { PQ_PAGES_DEFAULT, PQ_PAGES_2M, PQ_PAGES_1G };
+
+// NUMA binding of that mapping: none, or node n
+#define PQ_NUMA_NONE	0
+#define PQ_NUMA_NODE(n)	((n) + 1)
+
+/**
+* Where pq_create_in puts a queue.  Fill in one of:
+*   buffer, length - caller memory, aligned to 64 bytes and at least
+*                    pq_footprint(capacity) long; pq_free leaves it
+*   alloc, release, ctx - alloc(bytes, ctx) returns 64-byte aligned
+*                    memory; pq_free hands it back to release
+*   neither - pq_create_in maps anonymous memory itself, with
+*             pages - PQ_PAGES_*; if no huge pages of that size are
+*                     reserved, normal pages with transparent huge
+*                     pages requested
+*             numa_node - PQ_NUMA_NODE(n) binds the pages to node
+*                         n; PQ_NUMA_NONE (0, so a zeroed region
+*                         binds nothing) leaves them unbound
+**/
+typedef struct pq_region {
+	void *buffer;
+	size_t length;
+	void *(*alloc)(size_t bytes, void *ctx);
+	void (*release)(void *mem, size_t bytes, void *ctx);
+	void *ctx;
+	int pages;
+	int numa_node;
+} PQ_REGION;
+
+/**
+* Function: pq_footprint
+* Parameters: capacity - as in pq_create
+* Returns: exact number of bytes pq_create_in needs for a queue of the
+*          given capacity (0 if the capacity is out of range)
+*
+*/
+extern size_t pq_footprint(int capacity);
+
+/**
+* Function: pq_create_in
+* Parameters: capacity, min_heap - as in pq_create
+*             region - where to put the queue (see PQ_REGION); NULL
+*                      maps normal pages
+* Returns:  Pointer to empty priority queue whose struct and arrays all
+*           lie in one contiguous region, or NULL if the region cannot
+*           be had.
+* Desc: behaves like pq_create.  The capacity is fixed (pq_reserve
+*       fails).  The arrays use the pq_save image layout.
+*
+*/
+extern PQ * pq_create_in(int capacity, int min_heap, const PQ_REGION *region);
+
+/**
+* Function: pq_free
+* Parameters: PQ * pq
+* Returns: --
+* Desc: deallocates all memory associated with passed priority
+*       queue.
+*
+*/
+extern void pq_free(PQ * pq);
+
+/**
+* Function: pq_insert
+* Parameters: priority queue pq
+*             id of entry to insert
+*             priority of entry to insert
+* Returns: 1 on success; 0 on failure.
+*          fails if id is out of range or
+*            there is already an entry for id
+*          succeeds otherwise.
+*
+* Desc: self-explanatory
+*
+* Runtime:  O(log n)
+*
+*/
+extern int pq_insert(PQ * pq, int id, double priority);
+
+/**
+* Function: pq_build
+* Parameters: priority queue pq
+*             ids - array of n ids
+*             priorities - array of n priorities, priorities[i] goes
+*                          with ids[i]
+*             n - number of pairs
+* Returns: 1 on success; 0 on failure
+* Desc: replaces the contents of pq with the n given pairs.
+*       fails if any id is out of range or appears more than once;
+*       pq is then left empty.
+*
+* Runtime:  O(n)
+*
+*/
+extern int pq_build(PQ * pq, const int *ids, const double *priorities, int n);
+
+/**
+* Function: pq_build_parallel
+* Parameters: as pq_build
+*             threads - most threads to use (the caller's included)
+* Returns: 1 on success; 0 on failure
+* Desc: pq_build spread over threads: copying the input, checking and
+*       indexing the ids, and heapifying independent subtrees run on
+*       every thread; only the few heap levels above the subtrees are
+*       done by the calling thread.  The result is the same heap
+*       pq_build makes.  Threads are started per phase, and fewer are
+*       used for small inputs (about 64K pairs each at least).
+*       Engine queues, threads <= 1 and -DPQ_STATS builds go through
+*       pq_build.
+*
+* Runtime:  O(n / threads + threads log(n))
+*
+*/
+extern int pq_build_parallel(PQ * pq, const int *ids, const double *priorities, int n, int threads);
+
+/**
+* Function: pq_build_stream
+* Parameters: priority queue pq
+*             next - called as next(ctx, &id, &priority) until it
+*                    returns 0; each call gives one pair, in any order
+*             ctx - passed through to next
+*             threads - as in pq_build_parallel
+* Returns: 1 on success; 0 on failure
+* Desc: pq_build_parallel for input that is not in arrays: the pairs
+*       are read straight into the heap's own arrays (the only serial
+*       step, no copy is made) and built there.  On failure pq is
+*       left empty and the rest of the stream is not read.
+*
+* Runtime:  O(n) reading plus pq_build_parallel
+*
+*/
+extern int pq_build_stream(PQ * pq, int (*next)(void *ctx, int *id, double *priority), void *ctx, int threads);
+
+/**
+* Function: pq_insert_bulk
+* Parameters: as pq_build
+* Returns: 1 on success; 0 on failure
+* Desc: inserts n pairs into pq as if by n pq_insert calls.  Large
+*       batches (relative to the current size) re-heapify the whole
+*       queue instead of sifting each new entry.
+*       fails, leaving pq unchanged, if any id is out of range, is
+*       repeated or is already in pq.
+*
+* Runtime:  O(min(n log(size), size))
+*
+*/
+extern int pq_insert_bulk(PQ * pq, const int *ids, const double *priorities, int n);
+
+/**
+* Function: pq_offer
+* Parameters: priority queue pq (made by pq_create_topk)
+*             element id
+*             priority - the candidate's score
+* Returns: 1 if the candidate was taken; 0 if it was turned away or on
+*          failure (id out of range, queue without a top-K bound)
+* Desc: keeps the k best candidates.  While fewer than k ids are kept
+*       the candidate is inserted; after that it must beat the top,
+*       which it then replaces.  An id that is already kept keeps the
+*       better of its old and new priority (use pq_change_priority to
+*       make it worse).
+*       A candidate that does not beat the threshold costs one compare.
+*
+* Runtime:  O(1) when turned away, O(log k) otherwise
+*
+*/
+extern int pq_offer(PQ * pq, int id, double priority);
+
+/**
+* Function: pq_offer_bulk
+* Parameters: as pq_build
+* Returns: number of candidates taken
+* Desc: pq_offer for each pair in order, with the threshold held in a
+*       register between candidates.
+*
+* Runtime:  O(n) plus O(log k) per candidate taken
+*
+*/
+extern int pq_offer_bulk(PQ * pq, const int *ids, const double *priorities, int n);
+
+/**
+* Function: pq_merge
+* Parameters: priority queues dst and src, both min-heaps or both
+*             max-heaps
+* Returns: 1 on success; 0 on failure
+* Desc: moves every entry of src into dst, leaving src empty.  The ids
+*       of src are checked first: if one is out of dst's range (dst
+*       is grown if it is growable) or already in dst, nothing changes
+*       and 0 is returned.
+*       Array heap queues move their arrays in bulk and re-heapify as
+*       pq_insert_bulk does.  Two pq_create_pairing queues are melded:
+*       the nodes are copied and the roots linked, with no compares.
+*       Other engine queues cannot be merged.
+*
+* Runtime:  O(size(src) + min(size(src) log(size), size)) for array
+*           heaps, O(size(src)) for pairing heaps
+*
+*/
+extern int pq_merge(PQ * dst, PQ * src);
+
+/**
+* Function: pq_split
+* Parameters: priority queues src and dst as in pq_merge (array heap
+*             queues only)
+*             pick - called as pick(id, ctx) for the ids in src;
+*                    non-zero moves the entry to dst.  It must give
+*                    the same answer every time for an id.
+*             ctx - passed through to pick
+* Returns: 1 on success; 0 on failure
+* Desc: moves the entries of src that pick selects into dst, with the
+*       same up-front checks as pq_merge.  src is re-heapified once
+*       after the entries are taken out.  dst takes them as
+*       pq_insert_bulk does: a large batch (relative to the size of
+*       dst) re-heapifies dst, a small one is sifted up entry by entry.
+*
+* Runtime:  O(size(src) + min(n log(size(dst)), size(dst))) for n
+*           entries moved
+*
+*/
+extern int pq_split(PQ * src, PQ * dst, int (*pick)(int id, void *ctx), void *ctx);
+
+/**
+* Function: pq_change_priority
+* Parameters: priority queue ptr pq
+*             element id
+*             new_priority
+* Returns: 1 on success; 0 on failure
+* Desc: If there is an entry for the given id, its associated
+*       priority is changed to new_priority and the data
+*       structure is modified accordingly.
+*       Otherwise, it is a failure (id not in pq or out of range)
+* Runtime:  O(log n)
+*
+*/
+extern int pq_change_priority(PQ * pq, int id, double new_priority);
+
+/**
+* Function: pq_change_priorities
+* Parameters: priority queue ptr pq
+*             ids - array of n ids
+*             new_priorities - array of n priorities
+*             n - number of changes
+* Returns: number of ids whose priority was changed
+* Desc: same result as calling pq_change_priority(pq, ids[i],
+*       new_priorities[i]) for i = 0..n-1 (ids not in pq are skipped,
+*       a repeated id keeps its last priority).  When the batch is a
+*       large share of the queue the new priorities are written in
+*       place and the heap is rebuilt once instead.
+* Runtime:  O(min(n log n, size))
+*
+*/
+extern int pq_change_priorities(PQ * pq, const int *ids, const double *new_priorities, int n);
+
+/**
+* Function: pq_remove_by_id
+* Parameters: priority queue pq,
+*             element id
+* Returns: 1 on success; 0 on failure
+* Desc: if there is an entry associated with the given id, it is
+*       removed from the priority queue.
+*       Otherwise the data structure is unchanged and 0 is returned.
+* Runtime:  O(log n); O(1) plus amortized compaction with lazy removal
+*           (see pq_set_lazy_remove)
+*
+*/
+extern int pq_remove_by_id(PQ * pq, int id);
+
+/**
+* Function: pq_set_lazy_remove
+* Parameters: priority queue pq (made by pq_create or
+*             pq_create_growable)
+*             max_dead - share of the heap tombstones may take, in
+*                        [0, 1); 0 turns lazy removal off
+* Returns: 1 on success; 0 on failure (other kinds of queue, max_dead
+*          out of range, out of memory)
+* Desc: with lazy removal pq_remove_by_id only marks the entry dead
+*       (a tombstone, one byte per id) and leaves it in the heap.  The
+*       id is gone at once for pq_get_priority, pq_size and the rest,
+*       and can be inserted again, which reuses its slot.  pq_peek_top
+*       and pq_delete_top take tombstones off when they reach the top.
+*       Once tombstones exceed max_dead of the heap, they are all
+*       dropped and the heap is rebuilt in O(n), so entries removed
+*       long before they would reach the top cost no sift at all.
+*       pq_drain_sorted, pq_insert_bulk, pq_offer and pq_save compact
+*       first.  Turning lazy removal off compacts as well.
+*
+*/
+extern int pq_set_lazy_remove(PQ * pq, double max_dead);
+
+/**
+* Function: pq_get_priority
+* Parameters: priority queue pq
+*             elment id
+*             double pointer priority ("out" param)
+* Returns: 1 on success; 0 on failure
+* Desc: if there is an entry for given id, *priority is assigned
+*       the associated priority and 1 is returned.
+*       Otherwise 0 is returned and *priority has no meaning.
+* Runtime:  O(1)
+*
+*/
+extern int pq_get_priority(PQ * pq, int id, double *priority);
+
+/**
+* Function: pq_delete_top
+* Parameters: priority queue pq
+*             int pointers id and priority ("out" parameters)
+* Returns: 1 on success; 0 on failure (empty priority queue)
+* Desc: if queue is non-empty the "top" element is deleted and
+*       its id and priority are stored in *id and *priority;
+*       The "top" element will be either min or max (wrt priority)
+*       depending on how the priority queue was configured.
+*
+*       If queue is empty, 0 is returned.
+*
+* Runtime:  O(log n)
+*
+*/
+extern int pq_delete_top(PQ * pq, int *id, double *priority);
+
+/**
+* Function: pq_delete_top_k
+* Parameters: priority queue pq
+*             k - maximum number of entries to delete
+*             ids, priorities - arrays of at least k ("out" parameters)
+* Returns: number of entries deleted (less than k if pq runs empty)
+* Desc: deletes up to k entries from the top, as k calls to
+*       pq_delete_top would, storing them in ids[] and priorities[]
+*       in the order they came off the top.
+*
+* Runtime:  O(k log n)
+*
+*/
+extern int pq_delete_top_k(PQ * pq, int k, int *ids, double *priorities);
+
+/**
+* Function: pq_drain_sorted
+* Parameters: priority queue pq
+*             ids, priorities - arrays of at least pq_size(pq)
+*                               ("out" parameters)
+* Returns: number of entries drained
+* Desc: empties pq into ids[] and priorities[] in top-first order.
+*       The sort runs in place over the heap (heapsort); no memory is
+*       allocated.
+*
+* Runtime:  O(n log n)
+*
+*/
+extern int pq_drain_sorted(PQ * pq, int *ids, double *priorities);
+
+/**
+* Function: pq_peek_top
+* Parameters: priority queue pq
+*             int pointers id and priority ("out" parameters)
+* Returns: 1 on success; 0 on failure (empty priority queue)
+* Desc: if queue is non-empty information about the "top"
+*       element (id and priority) is stored in *id and *priority;
+*       The "top" element will be either min or max (wrt priority)
+*       depending on how the priority queue was configured.
+*
+*       The priority queue itself is unchanged (contrast with
+*       pq_delete_top).
+*
+*       If queue is empty, 0 is returned.
+*
+* Runtime:  O(1)
+*
+*/
+extern int pq_peek_top(PQ * pq, int *id, double *priority);
+
+/**
+* Function: pq_peek_bottom
+* Parameters: priority queue pq (made by pq_create_minmax)
+*             int pointers id and priority ("out" parameters)
+* Returns: 1 on success; 0 on failure (empty priority queue, or a
+*          queue without a bottom end)
+* Desc: as pq_peek_top for the other end: the max of a min-heap, the
+*       min of a max-heap.
+*
+* Runtime:  O(1)
+*
+*/
+extern int pq_peek_bottom(PQ * pq, int *id, double *priority);
+
+/**
+* Function: pq_delete_bottom
+* Parameters: priority queue pq (made by pq_create_minmax)
+*             int pointers id and priority ("out" parameters)
+* Returns: 1 on success; 0 on failure (empty priority queue, or a
+*          queue without a bottom end)
+* Desc: as pq_delete_top for the other end.
+*
+* Runtime:  O(log n)
+*
+*/
+extern int pq_delete_bottom(PQ * pq, int *id, double *priority);
+
+/**
+* Function:  pq_capacity
+* Parameters: priority queue pq
+* Returns: capacity of priority queue
+* Desc: see returns
+*
+*/
+extern int pq_capacity(PQ * pq);
+
+/**
+* Function: pq_size
+* Parameters: priority queue pq
+* Returns: number of elements currently in queue
+* Desc: see above
+*
+*/
+extern int pq_size(PQ * pq);
+
+/**
+* Instrumentation, collected only when pq.c is built with -DPQ_STATS
+* (otherwise the counting is compiled out and pq_stats returns 0).
+*
+* Every call is counted under one operation kind; the tombstones lazy
+* removal drops on its own are counted apart, under PQ_STAT_PURGE.
+* compares counts priority comparisons, moves counts entries written
+* into heap slots and levels counts heap levels an entry travelled
+* while sifting.
+* Histograms are log2 buckets: bucket 0 counts the value 0 and bucket
+* b counts values in [2^(b-1), 2^b).
+**/
+#define PQ_STATS_BUCKETS 32
+
+enum {
+	PQ_STAT_INSERT,			// pq_insert
+	PQ_STAT_CHANGE_UP,		// pq_change_priority towards the top (decrease-key on a min-heap)
+	PQ_STAT_CHANGE_DOWN,	// pq_change_priority away from the top
+	PQ_STAT_REMOVE,			// pq_remove_by_id
+	PQ_STAT_DELETE,			// every entry taken off the top (pq_delete_top, _k, pq_drain_sorted)
+	PQ_STAT_BULK,			// pq_build, pq_insert_bulk, rebuilding pq_change_priorities
+	PQ_STAT_PURGE,			// tombstones popped off the top or compacted away (lazy removal)
+	PQ_STAT_OPS
+};
+
+typedef struct pq_op_counters {
+	unsigned long long calls;
+	unsigned long long compares;
+	unsigned long long moves;
+	unsigned long long levels;
+} PQ_OP_COUNTERS;
+
+typedef struct pq_counters {
+	PQ_OP_COUNTERS ops[PQ_STAT_OPS];
+	unsigned long long depth[PQ_STATS_BUCKETS];	// levels per sift (bulk operations and purges excluded)
+	unsigned long long size[PQ_STATS_BUCKETS];	// live size seen by each counted operation but purges
+} PQ_COUNTERS;
+
+/**
+* Function: pq_stats
+* Parameters: priority queue pq
+*             PQ_COUNTERS pointer stats ("out" param)
+* Returns: 1 on success; 0 if pq.c was built without -DPQ_STATS or pq
+*          is not an array heap (engine queues are not instrumented)
+* Desc: copies the counters gathered since pq was created or last
+*       reset into *stats.  On failure *stats is zeroed.
+* Runtime:  O(1)
+*
+*/
+extern int pq_stats(PQ * pq, PQ_COUNTERS *stats);
+
+/**
+* Function: pq_stats_reset
+* Parameters: priority queue pq
+* Returns: --
+* Desc: clears the counters of pq.
+*
+*/
+extern void pq_stats_reset(PQ * pq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
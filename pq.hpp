@@ -0,0 +1,273 @@
+#ifndef PQ_HPP
+#define PQ_HPP
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+/**
+* General description:  header-only C++ version of the pq.c array heap.
+*   Stores pairs <id, priority> with ids in [0..capacity-1], at most
+*   one entry per id, and the same operations as pq.h.
+*
+*   The direction and the arity are template parameters, so the sift
+*   loops are compiled once per configuration: there is no min/max test
+*   inside them and the scan over a block of Arity children is a fixed
+*   length loop the compiler can unroll.
+*
+*   Compare(a, b) is true when priority a belongs nearer the top than b:
+*   std::less gives a min-heap, std::greater a max-heap.  (This is the
+*   opposite convention from std::priority_queue.)
+*
+*   Operations return false where the pq.h functions return 0; nothing
+*   is printed.  pq_shim.cpp puts the C interface on top of this.
+**/
+template <class Key = int, class Priority = double, class Compare = std::less<Priority>, int Arity = 2>
+class IndexedPriorityQueue {
+	static_assert(std::is_integral<Key>::value, "ids must be an integral type");
+	static_assert(Arity >= 2, "a heap node needs at least two children");
+
+public:
+	typedef std::size_t size_type;
+
+	explicit IndexedPriorityQueue(Key capacity, const Compare &compare = Compare())
+		: prio_(1), ids_(1), pos_(static_cast<size_type>(capacity), 0), better_(compare) {
+		prio_.reserve(pos_.size() + 1);
+		ids_.reserve(pos_.size() + 1);
+	}
+
+	Key capacity() const { return static_cast<Key>(pos_.size()); }
+	size_type size() const { return prio_.size() - 1; }
+	bool empty() const { return prio_.size() == 1; }
+
+	bool contains(Key id) const {
+		return in_range(id) && pos_[id] != 0;
+	}
+
+	/* raises the capacity to at least capacity and makes room for that
+	 * many entries, so inserts up to it never reallocate. the room at
+	 * least doubles, since a growable pq_insert reserves one id at a time
+	 */
+	void reserve(Key capacity) {
+		if(capacity <= this->capacity())
+			return;
+		pos_.resize(static_cast<size_type>(capacity), 0);
+		if(prio_.capacity() < pos_.size() + 1){
+			size_type room = pos_.size() + 1 > 2 * prio_.capacity() ? pos_.size() + 1 : 2 * prio_.capacity();
+			prio_.reserve(room);
+			ids_.reserve(room);
+		}
+	}
+
+	bool insert(Key id, const Priority &priority) {
+		if(!in_range(id) || pos_[id] != 0)
+			return false;
+		prio_.push_back(priority);
+		ids_.push_back(id);
+		pos_[id] = static_cast<index_type>(size());
+		sift_up(size());
+		return true;
+	}
+
+	bool change_priority(Key id, const Priority &priority) {
+		if(!contains(id))
+			return false;
+		size_type i = pos_[id];
+		bool up = better_(priority, prio_[i]);
+		prio_[i] = priority;
+		if(up)
+			sift_up(i);
+		else
+			sift_down(i);
+		return true;
+	}
+
+	bool remove_by_id(Key id) {
+		if(!contains(id))
+			return false;
+		size_type i = pos_[id];
+		pos_[id] = 0;
+		take_last_into(i);
+		return true;
+	}
+
+	bool get_priority(Key id, Priority &priority) const {
+		if(!contains(id))
+			return false;
+		priority = prio_[pos_[id]];
+		return true;
+	}
+
+	bool peek_top(Key &id, Priority &priority) const {
+		if(empty())
+			return false;
+		id = ids_[1];
+		priority = prio_[1];
+		return true;
+	}
+
+	bool delete_top(Key &id, Priority &priority) {
+		if(empty())
+			return false;
+		id = ids_[1];
+		priority = prio_[1];
+		pos_[id] = 0;
+		take_last_into(1);
+		return true;
+	}
+
+	/* adds n entries at once (as pq_insert_bulk). all or nothing: if any
+	 * id is out of range, already queued or repeated in the batch the
+	 * queue is left unchanged and false is returned. large batches are
+	 * merged by one bottom-up rebuild instead of n sift-ups.
+	 */
+	bool insert_bulk(const Key *ids, const Priority *priorities, size_type n) {
+		size_type old = size();
+		size_type i;
+		if(!claim(ids, n))
+			return false;
+		prio_.insert(prio_.end(), priorities, priorities + n);
+		ids_.insert(ids_.end(), ids, ids + n);
+		if(n * depth() > size())
+			heapify();
+		else
+			for(i = old + 1; i <= size(); i++)
+				sift_up(i);
+		return true;
+	}
+
+	//replaces the contents with the n entries (as pq_build), O(n)
+	bool build(const Key *ids, const Priority *priorities, size_type n) {
+		clear();
+		return insert_bulk(ids, priorities, n);
+	}
+
+	void clear() {
+		size_type i;
+		for(i = 1; i <= size(); i++)
+			pos_[ids_[i]] = 0;
+		prio_.resize(1);
+		ids_.resize(1);
+	}
+
+private:
+	typedef typename std::make_unsigned<Key>::type index_type;
+
+	//priorities and ids in heap order, index 0 unused; pos_ maps id -> heap index (0 = absent)
+	std::vector<Priority> prio_;
+	std::vector<Key> ids_;
+	std::vector<index_type> pos_;
+	Compare better_;
+
+	static size_type parent(size_type i) { return (i - 2) / Arity + 1; }
+	static size_type first_child(size_type i) { return (i - 1) * Arity + 2; }
+
+	bool in_range(Key id) const {
+		return id >= 0 && static_cast<size_type>(id) < pos_.size();
+	}
+
+	size_type depth() const {
+		size_type d = 0, i;
+		for(i = size(); i > 1; i = parent(i))
+			d++;
+		return d;
+	}
+
+	//fills heap slot i with the last entry and restores the order around it
+	void take_last_into(size_type i) {
+		size_type last = size();
+		if(i != last){
+			bool up = better_(prio_[last], prio_[i]);
+			prio_[i] = prio_[last];
+			ids_[i] = ids_[last];
+			pos_[ids_[i]] = static_cast<index_type>(i);
+			prio_.pop_back();
+			ids_.pop_back();
+			if(up)
+				sift_up(i);
+			else
+				sift_down(i);
+		}
+		else {
+			prio_.pop_back();
+			ids_.pop_back();
+		}
+	}
+
+	void sift_up(size_type i) {
+		Priority x = prio_[i];
+		Key d = ids_[i];
+		size_type p;
+		while(i > 1 && better_(x, prio_[p = parent(i)])){
+			prio_[i] = prio_[p];
+			ids_[i] = ids_[p];
+			pos_[ids_[i]] = static_cast<index_type>(i);
+			i = p;
+		}
+		prio_[i] = x;
+		ids_[i] = d;
+		pos_[d] = static_cast<index_type>(i);
+	}
+
+	//index of the best child of i, or 0 if i is a leaf
+	size_type best_child(size_type i) const {
+		size_type child = first_child(i), n = size(), best, k;
+		if(child > n)
+			return 0;
+		best = child;
+		if(child + Arity - 1 <= n){
+			for(k = 1; k < Arity; k++)
+				if(better_(prio_[child + k], prio_[best]))
+					best = child + k;
+		}
+		else {
+			for(k = child + 1; k <= n; k++)
+				if(better_(prio_[k], prio_[best]))
+					best = k;
+		}
+		return best;
+	}
+
+	void sift_down(size_type i, bool track = true) {
+		Priority x = prio_[i];
+		Key d = ids_[i];
+		size_type best;
+		while((best = best_child(i)) != 0 && better_(prio_[best], x)){
+			prio_[i] = prio_[best];
+			ids_[i] = ids_[best];
+			if(track)
+				pos_[ids_[i]] = static_cast<index_type>(i);
+			i = best;
+		}
+		prio_[i] = x;
+		ids_[i] = d;
+		if(track)
+			pos_[d] = static_cast<index_type>(i);
+	}
+
+	//Floyd's bottom-up build; pos_ is rewritten in one pass at the end
+	void heapify() {
+		size_type i;
+		for(i = size() > 1 ? parent(size()) : 0; i >= 1; i--)
+			sift_down(i, false);
+		for(i = 1; i <= size(); i++)
+			pos_[ids_[i]] = static_cast<index_type>(i);
+	}
+
+	//marks the batch's ids as queued, undoing everything if one is taken
+	bool claim(const Key *ids, size_type n) {
+		size_type i;
+		for(i = 0; i < n; i++){
+			if(!in_range(ids[i]) || pos_[ids[i]] != 0){
+				while(i-- > 0)
+					pos_[ids[i]] = 0;
+				return false;
+			}
+			pos_[ids[i]] = static_cast<index_type>(size() + 1 + i);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "pq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* single-threaded microbenchmarks.
+ *
+ * for every size 1e3, 1e4, ... up to -n, min and max heaps and each
+ * priority distribution, times insert, peek_top, delete_top,
+ * change_priority (priorities increased and decreased) and
+ * remove_by_id over n operations, and reports ns/op, Mops/s and the
+ * hardware cache-miss and branch-miss counts for the run (-1 where
+ * perf_event is not available).
+ *
+ * -q levels draws whole-number priorities from [0, levels) instead,
+ * as the bucket engine needs (it defaults to 4096 levels).
+ *
+ * usage: pq_bench [-n max_size] [-f csv|json] [-e heap|pairing|compact|bucket]
+ *                 [-q levels]
+ */
+
+enum { UNIFORM, SORTED, REVERSE, DUPLICATES, NDISTS };
+static const char *dist_names[NDISTS] = { "uniform", "sorted", "reverse", "duplicates" };
+
+typedef struct counters {
+	int cache_fd;
+	int branch_fd;
+	long long cache_misses;
+	long long branch_misses;
+	double start;
+} COUNTERS;
+
+static int json;
+static int first_row = 1;
+static const char *engine = "heap";
+static int levels;		//whole-number priorities in [0, levels) when non-zero
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int perf_open(unsigned long long config){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void start(COUNTERS *c){
+	if(c->cache_fd >= 0){
+		ioctl(c->cache_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(c->cache_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	if(c->branch_fd >= 0){
+		ioctl(c->branch_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(c->branch_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	c->start = now();
+}
+
+//stops the counters and returns the elapsed nanoseconds
+static double stop(COUNTERS *c){
+	double elapsed = now() - c->start;
+	c->cache_misses = c->branch_misses = -1;
+	if(c->cache_fd >= 0){
+		ioctl(c->cache_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if(read(c->cache_fd, &c->cache_misses, sizeof(long long)) != sizeof(long long))
+			c->cache_misses = -1;
+	}
+	if(c->branch_fd >= 0){
+		ioctl(c->branch_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if(read(c->branch_fd, &c->branch_misses, sizeof(long long)) != sizeof(long long))
+			c->branch_misses = -1;
+	}
+	return elapsed;
+}
+
+static void report(const char *op, int min_heap, int dist, int n, int ops, double ns, COUNTERS *c){
+	const char *heap = min_heap ? "min" : "max";
+	if(json){
+		printf("%s\n  {\"engine\": \"%s\", \"op\": \"%s\", \"heap\": \"%s\", \"dist\": \"%s\", \"n\": %d, "
+				"\"ops\": %d, \"ns_per_op\": %.2f, \"mops\": %.3f, \"cache_misses\": %lld, \"branch_misses\": %lld}",
+				first_row ? "[" : ",", engine, op, heap, dist_names[dist], n, ops,
+				ns / ops, ops / ns * 1e3, c->cache_misses, c->branch_misses);
+	}
+	else {
+		if(first_row)
+			printf("engine,op,heap,dist,n,ops,ns_per_op,mops,cache_misses,branch_misses\n");
+		printf("%s,%s,%s,%s,%d,%d,%.2f,%.3f,%lld,%lld\n", engine, op, heap, dist_names[dist], n, ops,
+				ns / ops, ops / ns * 1e3, c->cache_misses, c->branch_misses);
+	}
+	first_row = 0;
+	fflush(stdout);
+}
+
+static PQ * create(int n, int min_heap){
+	if(strcmp(engine, "pairing") == 0)
+		return pq_create_pairing(n, min_heap);
+	if(strcmp(engine, "compact") == 0)
+		return pq_create_compact(n, min_heap, PQ_KEY_FLOAT32);
+	if(strcmp(engine, "bucket") == 0)
+		return pq_create_bucket(n, min_heap, 0, levels + 64);	//room for change_priority_increase
+	return pq_create(n, min_heap);
+}
+
+//priorities in insertion order for the distribution
+static void gen_priorities(double *p, int n, int dist){
+	int i;
+	for(i = 0; i < n; i++){
+		if(levels && dist != DUPLICATES){
+			switch(dist){
+			case UNIFORM:	p[i] = next_rand() % levels; break;
+			case SORTED:	p[i] = (long long)i * levels / n; break;
+			case REVERSE:	p[i] = (long long)(n - 1 - i) * levels / n; break;
+			}
+			continue;
+		}
+		switch(dist){
+		case UNIFORM:		p[i] = (double)(next_rand() >> 11) / (1ULL << 53); break;
+		case SORTED:		p[i] = i; break;
+		case REVERSE:		p[i] = n - i; break;
+		case DUPLICATES:	p[i] = next_rand() % 16; break;
+		}
+	}
+}
+
+static void shuffle(int *a, int n){
+	int i, j, t;
+	for(i = n - 1; i > 0; i--){
+		j = next_rand() % (i + 1);
+		t = a[i];
+		a[i] = a[j];
+		a[j] = t;
+	}
+}
+
+static void run(int n, int min_heap, int dist, COUNTERS *c, int *ids, int *order, double *p){
+	PQ *pq;
+	int i, id;
+	double priority, ns;
+
+	for(i = 0; i < n; i++)
+		ids[i] = order[i] = i;
+	shuffle(ids, n);
+	shuffle(order, n);
+	gen_priorities(p, n, dist);
+
+	pq = create(n, min_heap);
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_insert(pq, ids[i], p[i]);
+	ns = stop(c);
+	report("insert", min_heap, dist, n, n, ns, c);
+
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_peek_top(pq, &id, &priority);
+	ns = stop(c);
+	report("peek_top", min_heap, dist, n, n, ns, c);
+
+	//every priority increases by a random step, then decreases back to where it was
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_change_priority(pq, ids[order[i]], p[order[i]] + 1 + next_rand() % 64);
+	ns = stop(c);
+	report("change_priority_increase", min_heap, dist, n, n, ns, c);
+
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_change_priority(pq, ids[order[i]], p[order[i]]);
+	ns = stop(c);
+	report("change_priority_decrease", min_heap, dist, n, n, ns, c);
+
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_delete_top(pq, &id, &priority);
+	ns = stop(c);
+	report("delete_top", min_heap, dist, n, n, ns, c);
+
+	//refill, then remove in an order unrelated to the heap
+	for(i = 0; i < n; i++)
+		pq_insert(pq, ids[i], p[i]);
+	start(c);
+	for(i = 0; i < n; i++)
+		pq_remove_by_id(pq, order[i]);
+	ns = stop(c);
+	report("remove_by_id", min_heap, dist, n, n, ns, c);
+
+	pq_free(pq);
+}
+
+int main(int argc, char **argv){
+	int max_n = 10000000;
+	int opt, min_heap, dist;
+	long n;		//the last n *= 10 may pass INT_MAX
+	COUNTERS c;
+
+	while((opt = getopt(argc, argv, "n:f:e:q:")) != -1){
+		switch(opt){
+		case 'n': max_n = atoi(optarg); break;
+		case 'f': json = strcmp(optarg, "json") == 0; break;
+		case 'e': engine = optarg; break;
+		case 'q': levels = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n max_size] [-f csv|json] [-e heap|pairing|compact|bucket] [-q levels]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(strcmp(engine, "bucket") == 0 && levels <= 0)
+		levels = 4096;
+
+	c.cache_fd = perf_open(PERF_COUNT_HW_CACHE_MISSES);
+	c.branch_fd = perf_open(PERF_COUNT_HW_BRANCH_MISSES);
+	if(c.cache_fd < 0 || c.branch_fd < 0)
+		fprintf(stderr, "perf_event unavailable, counters reported as -1\n");
+
+	int *ids = malloc(sizeof(int) * max_n);
+	int *order = malloc(sizeof(int) * max_n);
+	double *p = malloc(sizeof(double) * max_n);
+	for(n = 1000; n <= max_n; n *= 10)
+		for(min_heap = 1; min_heap >= 0; min_heap--)
+			for(dist = 0; dist < NDISTS; dist++)
+				run(n, min_heap, dist, &c, ids, order, p);
+	if(json)
+		printf("\n]\n");
+
+	free(ids);
+	free(order);
+	free(p);
+	return 0;
+}
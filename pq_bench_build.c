@@ -0,0 +1,163 @@
+#include "pq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/* bulk load benchmark.
+ *
+ * builds a queue of n entries, ids shuffled and priorities random, with
+ * pq_build and then with pq_build_parallel and pq_build_stream on 1, 2,
+ * 4, ... up to max_threads threads. stream_copy streams into a
+ * growable queue made to fall back to malloc'd arrays, which start at
+ * capacity 1 and are copied each time they grow. every threaded build
+ * is drained and compared with the drain of the pq_build heap
+ * (priorities have no ties, so equal heaps drain equally).
+ *
+ * usage: pq_bench_build [-n entries] [-t max_threads]
+ * output: kind,threads,n,ms,speedup,match
+ */
+
+typedef struct stream {
+	const int *ids;
+	const double *priorities;
+	int n;
+	int next;
+} STREAM;
+
+static double now_ms(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static int read_pair(void *ctx, int *id, double *priority){
+	STREAM *s = ctx;
+	if(s->next == s->n)
+		return 0;
+	*id = s->ids[s->next];
+	*priority = s->priorities[s->next];
+	s->next++;
+	return 1;
+}
+
+/* an empty growable queue on the malloc fallback: the address space
+ * limit is lowered while it is created, so reserving room for
+ * PQ_MAX_CAPACITY ids fails. NULL if the limit cannot be set.
+ */
+static PQ * create_unreserved(int min_heap){
+	struct rlimit old, low;
+	long pages;
+	FILE *f;
+	PQ *pq;
+
+	if(getrlimit(RLIMIT_AS, &old) != 0 || (f = fopen("/proc/self/statm", "r")) == NULL)
+		return NULL;
+	if(fscanf(f, "%ld", &pages) != 1)
+		pages = -1;
+	fclose(f);
+	if(pages < 0)
+		return NULL;
+	//what is mapped now plus room for malloc's own bookkeeping
+	low = old;
+	low.rlim_cur = (rlim_t)pages * sysconf(_SC_PAGESIZE) + (64 << 20);
+	if(old.rlim_cur != RLIM_INFINITY && old.rlim_cur < low.rlim_cur)
+		low.rlim_cur = old.rlim_cur;
+	if(setrlimit(RLIMIT_AS, &low) != 0)
+		return NULL;
+	pq = pq_create_growable(1, min_heap);
+	setrlimit(RLIMIT_AS, &old);
+	return pq;
+}
+
+//1 if pq drains to exactly want_ids (pq is left empty)
+static int drains_to(PQ *pq, const int *want_ids, int *ids, double *priorities){
+	int i, n = pq_drain_sorted(pq, ids, priorities);
+	for(i = 0; i < n; i++)
+		if(ids[i] != want_ids[i])
+			return 0;
+	return 1;
+}
+
+int main(int argc, char **argv){
+	int n = 10000000, max_threads = 64, opt, i, j, t, kind, tmp;
+	int *ids, *want, *out_ids;
+	double *priorities, *out_priorities, start, base, ms;
+	unsigned long long rng = 88172645463325252ULL;
+	static const char *kinds[] = { "parallel", "stream", "stream_copy" };
+	STREAM s;
+	PQ *pq, *target;
+
+	while((opt = getopt(argc, argv, "n:t:")) != -1){
+		switch(opt){
+		case 'n': n = atoi(optarg); break;
+		case 't': max_threads = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n entries] [-t max_threads]\n", argv[0]);
+			return 1;
+		}
+	}
+	ids = malloc(sizeof(int) * n);
+	want = malloc(sizeof(int) * n);
+	out_ids = malloc(sizeof(int) * n);
+	priorities = malloc(sizeof(double) * n);
+	out_priorities = malloc(sizeof(double) * n);
+	if(ids == NULL || want == NULL || out_ids == NULL || priorities == NULL || out_priorities == NULL){
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for(i = 0; i < n; i++){
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		j = (int)(rng % (i + 1));
+		tmp = ids[j];
+		ids[j] = i;
+		ids[i] = i == j ? i : tmp;
+		priorities[i] = (rng >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	printf("kind,threads,n,ms,speedup,match\n");
+	//the first build only faults the arrays in
+	pq = pq_create(n, 1);
+	pq_build(pq, ids, priorities, n);
+	start = now_ms();
+	pq_build(pq, ids, priorities, n);
+	base = now_ms() - start;
+	printf("build,1,%d,%.1f,1.00,1\n", n, base);
+	fflush(stdout);
+	pq_drain_sorted(pq, want, out_priorities);
+
+	for(kind = 0; kind < 3; kind++){
+		for(t = 1; t <= max_threads; t *= 2){
+			s.ids = ids;
+			s.priorities = priorities;
+			s.n = n;
+			s.next = 0;
+			target = pq;
+			if(kind == 2 && (target = create_unreserved(1)) == NULL){
+				fprintf(stderr, "cannot lower the address space limit, stream_copy skipped\n");
+				break;
+			}
+			start = now_ms();
+			if(kind == 0)
+				pq_build_parallel(target, ids, priorities, n, t);
+			else
+				pq_build_stream(target, read_pair, &s, t);
+			ms = now_ms() - start;
+			printf("%s,%d,%d,%.1f,%.2f,%d\n", kinds[kind], t, n, ms, base / ms,
+				drains_to(target, want, out_ids, out_priorities));
+			fflush(stdout);
+			if(target != pq)
+				pq_free(target);
+		}
+	}
+	pq_free(pq);
+	free(ids);
+	free(want);
+	free(out_ids);
+	free(priorities);
+	free(out_priorities);
+	return 0;
+}
@@ -0,0 +1,108 @@
+#include "pq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* multi-threaded throughput benchmark.
+ *
+ * "hold" model: every thread repeatedly deletes the top and inserts the
+ * same id back with a later priority, so the queue stays at its
+ * pre-filled size and inserts never collide. the mutex baseline takes a
+ * global lock around each call, as a caller wrapping pq.c would. the
+ * relaxed multiqueue uses two sub-queues per thread. each queue kind is
+ * run with 1, 2, 4, ... up to the given number of threads.
+ *
+ * usage: pq_bench_mt [max_threads] [ops_per_thread]
+ * output: kind,threads,mops_per_sec
+ */
+
+#define PREFILL		100000
+
+typedef struct bench_queue {
+	PQ *pq;
+	pthread_mutex_t *lock;	//non-NULL for the mutex-wrapped baseline
+} BENCH_QUEUE;
+
+typedef struct worker {
+	BENCH_QUEUE *q;
+	unsigned seed;
+	int ops;
+	pthread_t thread;
+} WORKER;
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void *work(void *arg){
+	WORKER *w = arg;
+	BENCH_QUEUE *q = w->q;
+	int i, id;
+	double priority;
+
+	for(i = 0; i < w->ops; i++){
+		if(q->lock)
+			pthread_mutex_lock(q->lock);
+		pq_delete_top(q->pq, &id, &priority);
+		if(q->lock){
+			pthread_mutex_unlock(q->lock);
+			pthread_mutex_lock(q->lock);
+		}
+		pq_insert(q->pq, id, priority + rand_r(&w->seed) / (double)RAND_MAX);
+		if(q->lock)
+			pthread_mutex_unlock(q->lock);
+	}
+	return NULL;
+}
+
+static double run(const char *kind, int threads, int ops){
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	BENCH_QUEUE q;
+	WORKER *w = malloc(sizeof(WORKER) * threads);
+	int i;
+
+	q.lock = NULL;
+	if(strcmp(kind, "mutex") == 0){
+		q.pq = pq_create(PREFILL, 1);
+		q.lock = &lock;
+	}
+	else if(strcmp(kind, "multiqueue") == 0)
+		q.pq = pq_create_multiqueue(PREFILL, 1, 2 * threads);
+	else
+		q.pq = pq_create_concurrent(PREFILL, 1);
+	for(i = 0; i < PREFILL; i++)
+		pq_insert(q.pq, i, rand() / (double)RAND_MAX);
+
+	double start = now();
+	for(i = 0; i < threads; i++){
+		w[i].q = &q;
+		w[i].seed = i + 1;
+		w[i].ops = ops;
+		pthread_create(&w[i].thread, NULL, work, &w[i]);
+	}
+	for(i = 0; i < threads; i++)
+		pthread_join(w[i].thread, NULL);
+	double elapsed = now() - start;
+
+	pq_free(q.pq);
+	free(w);
+	return 2.0 * ops * threads / elapsed / 1e6;
+}
+
+int main(int argc, char **argv){
+	int max_threads = argc > 1 ? atoi(argv[1]) : 32;
+	int ops = argc > 2 ? atoi(argv[2]) : 200000;
+	int t;
+
+	printf("kind,threads,mops_per_sec\n");
+	for(t = 1; t <= max_threads; t *= 2){
+		printf("mutex,%d,%.3f\n", t, run("mutex", t, ops));
+		printf("flat_combining,%d,%.3f\n", t, run("flat_combining", t, ops));
+		printf("multiqueue,%d,%.3f\n", t, run("multiqueue", t, ops));
+	}
+	return 0;
+}
@@ -0,0 +1,228 @@
+#include "pq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/* timeout workload benchmark.
+ *
+ * models a server's connection timeouts. a connection opens every dt
+ * seconds and starts a timer that fires TIMEOUT (+-50%) later. when it
+ * opens, the connection's fate is drawn: with probability cancel it
+ * closes, cancelling its timer, at a random point before the timer
+ * fires; with probability keepalive it sees activity once before then,
+ * which pushes the timer back by a fresh timeout. on every step the
+ * server peeks at the top and takes off the timers that are due. dt is
+ * set so about n connections are open at a time.
+ *
+ * the run is first recorded as a trace of queue calls, then replayed
+ * against each engine ("lazy" is pq_create with lazy removal). the
+ * first part of the trace fills the queue and is not timed; the timed
+ * part is -s steps long.
+ *
+ * usage: pq_bench_timer [-n max_open] [-s steps] [-c cancel]
+ *                       [-r keepalive] [-t tick]
+ * output: engine,n,cancel,keepalive,calls,ns_per_call,mops
+ */
+
+#define TIMEOUT		30.0	//seconds, mean
+
+enum { CALL_INSERT, CALL_CHANGE, CALL_REMOVE, CALL_PEEK, CALL_DELETE };
+
+enum { PENDING_CLOSE = 1, PENDING_KEEPALIVE = 2 };
+
+typedef struct call {
+	int type;
+	int id;
+	double priority;
+} CALL;
+
+typedef struct trace {
+	CALL *calls;
+	long n;
+	long room;
+	long warm;		//calls before the timed part
+	int capacity;
+} TRACE;
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned long long next_rand(void){
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return rng;
+}
+
+static double uniform(void){
+	return (next_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now_ns(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void record(TRACE *t, int type, int id, double priority){
+	if(t->n == t->room){
+		t->room = t->room ? 2 * t->room : 1 << 20;
+		t->calls = realloc(t->calls, sizeof(CALL) * t->room);
+		if(t->calls == NULL){
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+	t->calls[t->n].type = type;
+	t->calls[t->n].id = id;
+	t->calls[t->n].priority = priority;
+	t->n++;
+}
+
+/* simulates the server with a pq.c heap as its event list. connection
+ * c has up to three events: its timer firing (id c), closing (id
+ * capacity + c) and its keepalive (id 2 * capacity + c).
+ */
+static void make_trace(TRACE *t, int n, long steps, double cancel, double keepalive){
+	int capacity = 2 * n, nfree = 0, id, c, kind;
+	int *free_ids = malloc(sizeof(int) * capacity);
+	char *pending = calloc(capacity, 1);	//PENDING_* events of each connection
+	PQ *events = pq_create(3 * capacity, 1);
+	double dt = TIMEOUT * (1 - cancel / 2 + keepalive / 2) / n;
+	double clock = 0, at, expiry;
+	long step, warm = (long)(2 * TIMEOUT / dt);
+
+	t->n = 0;
+	t->capacity = capacity;
+	for(id = capacity - 1; id >= 0; id--)
+		free_ids[nfree++] = id;
+	for(step = 0; step < warm + steps; step++){
+		if(step == warm)
+			t->warm = t->n;
+		clock += dt;
+		record(t, CALL_PEEK, 0, 0);
+		while(pq_size(events) > 0 && pq_peek_top(events, &id, &at) && at <= clock){
+			pq_delete_top(events, &id, &at);
+			c = id % capacity;
+			kind = id / capacity;
+			if(kind == 0){
+				//a keepalive can bring the timer forward, past the close
+				record(t, CALL_DELETE, c, 0);
+				record(t, CALL_PEEK, 0, 0);
+				if(pending[c] & PENDING_CLOSE)
+					pq_remove_by_id(events, capacity + c);
+				pending[c] = 0;
+				free_ids[nfree++] = c;
+			}
+			else if(kind == 1){
+				record(t, CALL_REMOVE, c, 0);
+				pq_remove_by_id(events, c);
+				if(pending[c] & PENDING_KEEPALIVE)
+					pq_remove_by_id(events, 2 * capacity + c);
+				pending[c] = 0;
+				free_ids[nfree++] = c;
+			}
+			else {
+				expiry = at + TIMEOUT * (0.5 + uniform());
+				record(t, CALL_CHANGE, c, expiry);
+				pending[c] &= ~PENDING_KEEPALIVE;
+				pq_change_priority(events, c, expiry);
+			}
+		}
+		if(nfree == 0)
+			continue;
+		c = free_ids[--nfree];
+		expiry = clock + TIMEOUT * (0.5 + uniform());
+		record(t, CALL_INSERT, c, expiry);
+		pq_insert(events, c, expiry);
+		if(uniform() < keepalive){
+			pq_insert(events, 2 * capacity + c, clock + (expiry - clock) * uniform());
+			pending[c] |= PENDING_KEEPALIVE;
+		}
+		if(uniform() < cancel){
+			pq_insert(events, capacity + c, clock + (expiry - clock) * uniform());
+			pending[c] |= PENDING_CLOSE;
+		}
+	}
+	free(free_ids);
+	free(pending);
+	pq_free(events);
+}
+
+static PQ * create(const char *engine, int capacity, double tick){
+	PQ *pq;
+	if(strcmp(engine, "pairing") == 0)
+		return pq_create_pairing(capacity, 1);
+	if(strcmp(engine, "wheel") == 0)
+		return pq_create_wheel(capacity, 1, tick);
+	pq = pq_create(capacity, 1);
+	if(strcmp(engine, "lazy") == 0)
+		pq_set_lazy_remove(pq, 0.5);
+	return pq;
+}
+
+static void replay(const CALL *calls, long n, PQ *pq){
+	int id;
+	double priority;
+	long i;
+	for(i = 0; i < n; i++){
+		switch(calls[i].type){
+		case CALL_INSERT: pq_insert(pq, calls[i].id, calls[i].priority); break;
+		case CALL_CHANGE: pq_change_priority(pq, calls[i].id, calls[i].priority); break;
+		case CALL_REMOVE: pq_remove_by_id(pq, calls[i].id); break;
+		case CALL_PEEK: if(pq_size(pq) > 0) pq_peek_top(pq, &id, &priority); break;
+		case CALL_DELETE: pq_delete_top(pq, &id, &priority); break;
+		}
+	}
+}
+
+static void run(const char *engine, const TRACE *t, int n, double cancel, double keepalive, double tick){
+	PQ *pq = create(engine, t->capacity, tick);
+	long calls = t->n - t->warm;
+	double start, ns;
+
+	replay(t->calls, t->warm, pq);
+	start = now_ns();
+	replay(t->calls + t->warm, calls, pq);
+	ns = now_ns() - start;
+	printf("%s,%d,%.2f,%.2f,%ld,%.2f,%.3f\n", engine, n, cancel, keepalive, calls, ns / calls, calls / ns * 1e3);
+	fflush(stdout);
+	pq_free(pq);
+}
+
+int main(int argc, char **argv){
+	static const char *engines[] = { "heap", "lazy", "pairing", "wheel" };
+	static const double default_cancels[] = { 0.5, 0.9, 0.99 };
+	const double *cancels = default_cancels;
+	int ncancels = 3;
+	int max_open = 1000000, opt, e, c;
+	long n;		//the last n *= 10 may pass INT_MAX
+	long steps = 1000000;
+	double cancel, keepalive = 0.2, tick = 0.001;
+	TRACE t = { NULL, 0, 0, 0, 0 };
+
+	while((opt = getopt(argc, argv, "n:s:c:r:t:")) != -1){
+		switch(opt){
+		case 'n': max_open = atoi(optarg); break;
+		case 's': steps = atol(optarg); break;
+		case 'c': cancel = atof(optarg); cancels = &cancel; ncancels = 1; break;
+		case 'r': keepalive = atof(optarg); break;
+		case 't': tick = atof(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-n max_open] [-s steps] [-c cancel] [-r keepalive] [-t tick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("engine,n,cancel,keepalive,calls,ns_per_call,mops\n");
+	for(n = 10000; n <= max_open; n *= 10){
+		for(c = 0; c < ncancels; c++){
+			make_trace(&t, n, steps, cancels[c], keepalive);
+			for(e = 0; e < (int)(sizeof(engines) / sizeof(engines[0])); e++)
+				run(engines[e], &t, n, cancels[c], keepalive, tick);
+		}
+	}
+	free(t.calls);
+	return 0;
+}
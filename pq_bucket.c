@@ -0,0 +1,264 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* bucket queue engine for whole-number priorities in a range [lo, hi]
+ * fixed at creation (QoS levels and the like). there is one bucket per
+ * priority value, numbered from the top of the queue (p - lo for a
+ * min-heap, hi - p for a max-heap), and every bucket is a doubly linked
+ * list threaded through an array indexed by id, so insert,
+ * change_priority and remove_by_id are O(1) and never compare
+ * priorities.
+ *
+ * the non-empty buckets are kept in a bitmap with summary levels on
+ * top: bit i of level l + 1 is set when word i of level l is non-zero,
+ * and the top level is a single word. the first non-empty bucket is
+ * found with one ctz per level, at most MAX_LEVELS for the largest
+ * range.
+ */
+
+#define MAX_LEVELS	5			//64^5 buckets
+#define MAX_BUCKETS	(1 << 26)
+#define NIL			-1
+#define ABSENT		-1			//bucket of an id that is not in the queue
+
+typedef struct bucket_node {
+	int prev;
+	int next;
+	int bucket;
+} BUCKET_NODE;
+
+typedef struct bucket_struct {
+	BUCKET_NODE *nodes;				//one node per id
+	int *head;						//first id in each bucket
+	uint64_t *bits[MAX_LEVELS];		//bits[0] has one bit per bucket
+	int levels;
+	int lo;
+	int hi;
+	int min_heap;
+	int size;
+	int capacity;
+} BUCKET;
+
+
+/* the bucket of priority, 0 if it is not a whole number in range
+ */
+static int bucket_of(BUCKET *b, double priority, int *k){
+	if(!(priority >= b->lo && priority <= b->hi) || priority != (double)(int)priority){
+		printf("ERROR: Priority is outside the bucket range.\n");
+		return 0;
+	}
+	*k = b->min_heap ? (int)priority - b->lo : b->hi - (int)priority;
+	return 1;
+}
+
+//sets the bit of bucket k and of every summary word that just became non-zero
+static void mark(BUCKET *b, int k){
+	int l;
+	uint64_t was;
+	for(l = 0; l < b->levels; l++){
+		was = b->bits[l][k >> 6];
+		b->bits[l][k >> 6] = was | (uint64_t)1 << (k & 63);
+		if(was != 0)
+			return;
+		k >>= 6;
+	}
+}
+
+static void unmark(BUCKET *b, int k){
+	int l;
+	for(l = 0; l < b->levels; l++){
+		b->bits[l][k >> 6] &= ~((uint64_t)1 << (k & 63));
+		if(b->bits[l][k >> 6] != 0)
+			return;
+		k >>= 6;
+	}
+}
+
+//first non-empty bucket, the queue must be non-empty
+static int first(BUCKET *b){
+	int l, k = 0;
+	for(l = b->levels - 1; l >= 0; l--)
+		k = k << 6 | __builtin_ctzll(b->bits[l][k]);
+	return k;
+}
+
+static void push(BUCKET *b, int id, int k){
+	BUCKET_NODE *n = &b->nodes[id];
+	n->bucket = k;
+	n->prev = NIL;
+	n->next = b->head[k];
+	if(n->next != NIL)
+		b->nodes[n->next].prev = id;
+	else
+		mark(b, k);
+	b->head[k] = id;
+}
+
+static void unlink_node(BUCKET *b, int id){
+	BUCKET_NODE *n = &b->nodes[id];
+	if(n->prev != NIL)
+		b->nodes[n->prev].next = n->next;
+	else {
+		b->head[n->bucket] = n->next;
+		if(n->next == NIL)
+			unmark(b, n->bucket);
+	}
+	if(n->next != NIL)
+		b->nodes[n->next].prev = n->prev;
+	n->bucket = ABSENT;
+}
+
+static double priority_of(BUCKET *b, int k){
+	return b->min_heap ? b->lo + k : b->hi - k;
+}
+
+static int in_queue(BUCKET *b, int id){
+	return id >= 0 && id < b->capacity && b->nodes[id].bucket != ABSENT;
+}
+
+static int bucket_insert(void *impl, int id, double priority){
+	BUCKET *b = impl;
+	int k;
+	if(id < 0 || b->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(b->nodes[id].bucket != ABSENT){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	if(!bucket_of(b, priority, &k))
+		return 0;
+	push(b, id, k);
+	b->size++;
+	return 1;
+}
+
+static int bucket_change_priority(void *impl, int id, double new_priority){
+	BUCKET *b = impl;
+	int k;
+	if(!in_queue(b, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	if(!bucket_of(b, new_priority, &k))
+		return 0;
+	if(k != b->nodes[id].bucket){
+		unlink_node(b, id);
+		push(b, id, k);
+	}
+	return 1;
+}
+
+static int bucket_remove_by_id(void *impl, int id){
+	BUCKET *b = impl;
+	if(!in_queue(b, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	unlink_node(b, id);
+	b->size--;
+	return 1;
+}
+
+static int bucket_get_priority(void *impl, int id, double *priority){
+	BUCKET *b = impl;
+	if(!in_queue(b, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = priority_of(b, b->nodes[id].bucket);
+	return 1;
+}
+
+static int bucket_peek_top(void *impl, int *id, double *priority){
+	BUCKET *b = impl;
+	int k;
+	if(b->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	k = first(b);
+	*id = b->head[k];
+	*priority = priority_of(b, k);
+	return 1;
+}
+
+static int bucket_delete_top(void *impl, int *id, double *priority){
+	BUCKET *b = impl;
+	if(!bucket_peek_top(impl, id, priority))
+		return 0;
+	unlink_node(b, *id);
+	b->size--;
+	return 1;
+}
+
+static int bucket_size(void *impl){
+	return ((BUCKET *)impl)->size;
+}
+
+static void bucket_free(void *impl){
+	BUCKET *b = impl;
+	int l;
+	for(l = 0; l < b->levels; l++)
+		free(b->bits[l]);
+	free(b->head);
+	free(b->nodes);
+	free(b);
+}
+
+static const PQ_ENGINE bucket_engine = {
+	bucket_insert,
+	bucket_change_priority,
+	bucket_remove_by_id,
+	bucket_get_priority,
+	bucket_delete_top,
+	bucket_peek_top,
+	bucket_size,
+	bucket_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_bucket(int capacity, int min_heap, int lo, int hi){
+	BUCKET *b;
+	int i, words, n;
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	if(hi < lo || (long)hi - lo >= MAX_BUCKETS){
+		printf("Priority range must hold between 1 and %d values!\n", MAX_BUCKETS);
+		exit(1);
+	}
+	n = hi - lo + 1;
+	b = malloc(sizeof(BUCKET));
+	if(b == NULL || (b->nodes = malloc(sizeof(BUCKET_NODE) * capacity)) == NULL
+			|| (b->head = malloc(sizeof(int) * n)) == NULL){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	b->levels = 0;
+	do {
+		words = (n + 63) / 64;
+		if((b->bits[b->levels++] = calloc(words, sizeof(uint64_t))) == NULL){
+			printf("ERROR: Out of memory!\n");
+			exit(1);
+		}
+		n = words;
+	} while(words > 1);
+	for(i = 0; i < capacity; i++)
+		b->nodes[i].bucket = ABSENT;
+	for(i = 0; i <= hi - lo; i++)
+		b->head[i] = NIL;
+	b->lo = lo;
+	b->hi = hi;
+	b->min_heap = min_heap;
+	b->size = 0;
+	b->capacity = capacity;
+	return pq_wrap(&bucket_engine, b, capacity, min_heap);
+}
@@ -0,0 +1,252 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* compact engine: every heap slot is one 64-bit key holding a 32-bit
+ * priority code in the high half and the id in the low half, so a
+ * comparison is one unsigned compare and a move is one 8-byte store.
+ * with the 4-byte pos index that is 12 bytes per entry against 16 for
+ * the double-precision heap in pq.c.
+ *
+ * priority codes sort like the priorities they stand for (flipped for
+ * a max-heap, so the heap below is always a min-heap on keys); equal
+ * priorities come off the top in id order. two encodings are offered:
+ *   PQ_KEY_FLOAT32 - priorities are rounded to the nearest float
+ *   PQ_KEY_UINT32  - priorities must be whole numbers in [0, 2^32)
+ */
+
+#define ARITY		4	//four 8-byte children fill half a cache line
+#define CACHE_LINE	64
+//keys skipped at the front so each block of children starts on a 32-byte boundary
+#define KEY_LEAD	((int)(CACHE_LINE / sizeof(uint64_t)) - 2)
+
+#define PARENT(i)		(((i) - 2) / ARITY + 1)
+#define FIRST_CHILD(i)	(((long)(i) - 1) * ARITY + 2)	//long: may pass INT_MAX
+#define KEY_ID(k)		((int)(uint32_t)(k))
+
+typedef struct compact_struct {
+	uint64_t *keys;	//heap of (code << 32 | id), index 0 unused
+	void *mem;		//allocation behind keys
+	int *pos;		//heap index of every id, 0 if absent
+	int size;
+	int capacity;
+	int min_heap;
+	int key_type;
+} COMPACT;
+
+
+//order preserving float -> unsigned mapping (negatives flipped below positives)
+static uint32_t encode_float(float f){
+	uint32_t u;
+	if(f == 0)
+		f = 0;	//treat -0.0 like 0.0
+	memcpy(&u, &f, sizeof(u));
+	return (u >> 31) ? ~u : u | 0x80000000u;
+}
+
+static float decode_float(uint32_t code){
+	float f;
+	code = (code >> 31) ? code & 0x7fffffffu : ~code;
+	memcpy(&f, &code, sizeof(f));
+	return f;
+}
+
+/* the code of priority, 0 if it cannot be represented (a non-integer or
+ * out of range priority for PQ_KEY_UINT32)
+ */
+static int encode(COMPACT *c, double priority, uint32_t *code){
+	if(c->key_type == PQ_KEY_UINT32){
+		if(!(priority >= 0 && priority <= UINT32_MAX) || priority != (double)(uint32_t)priority){
+			printf("ERROR: Priority does not fit a 32-bit key.\n");
+			return 0;
+		}
+		*code = (uint32_t)priority;
+	}
+	else
+		*code = encode_float((float)priority);
+	if(!c->min_heap)
+		*code = ~*code;
+	return 1;
+}
+
+static double decode(COMPACT *c, uint64_t key){
+	uint32_t code = (uint32_t)(key >> 32);
+	if(!c->min_heap)
+		code = ~code;
+	return c->key_type == PQ_KEY_UINT32 ? (double)code : (double)decode_float(code);
+}
+
+static void sift_up(COMPACT *c, int i){
+	uint64_t x = c->keys[i];
+	int parent;
+	while(i > 1 && x < c->keys[parent = PARENT(i)]){
+		c->keys[i] = c->keys[parent];
+		c->pos[KEY_ID(c->keys[i])] = i;
+		i = parent;
+	}
+	c->keys[i] = x;
+	c->pos[KEY_ID(x)] = i;
+}
+
+static void sift_down(COMPACT *c, int i){
+	uint64_t x = c->keys[i];
+	long child;
+	int best, k, end;
+	while((child = FIRST_CHILD(i)) <= c->size){
+		end = child + ARITY - 1 <= c->size ? child + ARITY - 1 : c->size;
+		best = child;
+		for(k = child + 1; k <= end; k++)
+			if(c->keys[k] < c->keys[best])
+				best = k;
+		if(!(c->keys[best] < x))
+			break;
+		c->keys[i] = c->keys[best];
+		c->pos[KEY_ID(c->keys[i])] = i;
+		i = best;
+	}
+	c->keys[i] = x;
+	c->pos[KEY_ID(x)] = i;
+}
+
+//fills slot i with the last key and sifts it whichever way it has to go
+static void take_last_into(COMPACT *c, int i){
+	uint64_t old = c->keys[i];
+	c->keys[i] = c->keys[c->size--];
+	if(i > c->size)
+		return;
+	c->pos[KEY_ID(c->keys[i])] = i;
+	if(c->keys[i] < old)
+		sift_up(c, i);
+	else
+		sift_down(c, i);
+}
+
+static int compact_insert(void *impl, int id, double priority){
+	COMPACT *c = impl;
+	uint32_t code;
+	if(id < 0 || c->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(c->pos[id] != 0){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	if(!encode(c, priority, &code))
+		return 0;
+	c->keys[++c->size] = (uint64_t)code << 32 | (uint32_t)id;
+	sift_up(c, c->size);
+	return 1;
+}
+
+static int compact_change_priority(void *impl, int id, double new_priority){
+	COMPACT *c = impl;
+	uint32_t code;
+	uint64_t old;
+	int i;
+	if(id < 0 || c->capacity <= id || c->pos[id] == 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	if(!encode(c, new_priority, &code))
+		return 0;
+	i = c->pos[id];
+	old = c->keys[i];
+	c->keys[i] = (uint64_t)code << 32 | (uint32_t)id;
+	if(c->keys[i] < old)
+		sift_up(c, i);
+	else
+		sift_down(c, i);
+	return 1;
+}
+
+static int compact_remove_by_id(void *impl, int id){
+	COMPACT *c = impl;
+	int i;
+	if(id < 0 || c->capacity <= id || c->pos[id] == 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	i = c->pos[id];
+	c->pos[id] = 0;
+	take_last_into(c, i);
+	return 1;
+}
+
+static int compact_get_priority(void *impl, int id, double *priority){
+	COMPACT *c = impl;
+	if(id < 0 || c->capacity <= id || c->pos[id] == 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = decode(c, c->keys[c->pos[id]]);
+	return 1;
+}
+
+static int compact_peek_top(void *impl, int *id, double *priority){
+	COMPACT *c = impl;
+	if(c->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	*id = KEY_ID(c->keys[1]);
+	*priority = decode(c, c->keys[1]);
+	return 1;
+}
+
+static int compact_delete_top(void *impl, int *id, double *priority){
+	COMPACT *c = impl;
+	if(!compact_peek_top(impl, id, priority))
+		return 0;
+	c->pos[*id] = 0;
+	take_last_into(c, 1);
+	return 1;
+}
+
+static int compact_size(void *impl){
+	return ((COMPACT *)impl)->size;
+}
+
+static void compact_free(void *impl){
+	COMPACT *c = impl;
+	free(c->mem);
+	free(c->pos);
+	free(c);
+}
+
+static const PQ_ENGINE compact_engine = {
+	compact_insert,
+	compact_change_priority,
+	compact_remove_by_id,
+	compact_get_priority,
+	compact_delete_top,
+	compact_peek_top,
+	compact_size,
+	compact_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_compact(int capacity, int min_heap, int key_type){
+	COMPACT *c;
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	c = malloc(sizeof(COMPACT));
+	if(c == NULL || posix_memalign(&c->mem, CACHE_LINE, sizeof(uint64_t) * ((size_t)capacity + 1 + KEY_LEAD)) != 0
+			|| (c->pos = calloc(capacity, sizeof(int))) == NULL){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	c->keys = (uint64_t *)c->mem + KEY_LEAD;
+	c->size = 0;
+	c->capacity = capacity;
+	c->min_heap = min_heap;
+	c->key_type = key_type;
+	return pq_wrap(&compact_engine, c, capacity, min_heap);
+}
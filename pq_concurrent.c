@@ -0,0 +1,242 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+/* thread-safe engine using flat combining. a thread publishes its
+ * operation in a slot and then either waits for it to be answered or,
+ * if nobody holds the combiner lock, takes it and answers every pending
+ * slot against an ordinary array heap in one pass. the heap is only
+ * ever touched by the combiner, so it stays strictly ordered, and the
+ * lock is taken once per batch rather than once per operation.
+ *
+ * while combining, a delete_top that finds a pending insert better than
+ * the current top takes that entry directly (the insert and the delete
+ * linearize back to back), so neither touches the heap.
+ */
+
+#define FC_SLOTS	64
+#define FC_SPINS	64	//busy polls before yielding the cpu
+
+enum { FC_FREE, FC_CLAIMED, FC_PENDING, FC_DONE };
+enum { OP_INSERT, OP_CHANGE, OP_REMOVE, OP_GET, OP_DELETE, OP_PEEK, OP_SIZE };
+
+typedef struct fc_record {
+	_Atomic int state;
+	int op;
+	int id;			//in: id, out: id for delete/peek
+	double priority;	//in: priority, out: priority for get/delete/peek
+	int result;
+} __attribute__((aligned(64))) FC_RECORD;
+
+typedef struct fc_struct {
+	PQ *pq;			//sequential queue, only used by the combiner
+	int min_heap;
+	_Atomic int lock;	//held by the combining thread
+	FC_RECORD slots[FC_SLOTS];
+} FC;
+
+//slot each thread tries first, spread round robin over the slots
+static _Thread_local int slot_hint = -1;
+static _Atomic int next_hint;
+
+
+//true if a is strictly closer to the top than b
+static int better(FC *fc, double a, double b){
+	return fc->min_heap ? a < b : a > b;
+}
+
+static void apply(FC *fc, FC_RECORD *r){
+	switch(r->op){
+	case OP_INSERT:
+		r->result = pq_insert(fc->pq, r->id, r->priority);
+		break;
+	case OP_CHANGE:
+		r->result = pq_change_priority(fc->pq, r->id, r->priority);
+		break;
+	case OP_REMOVE:
+		r->result = pq_remove_by_id(fc->pq, r->id);
+		break;
+	case OP_GET:
+		r->result = pq_get_priority(fc->pq, r->id, &r->priority);
+		break;
+	case OP_DELETE:
+		r->result = pq_delete_top(fc->pq, &r->id, &r->priority);
+		break;
+	case OP_PEEK:
+		r->result = pq_peek_top(fc->pq, &r->id, &r->priority);
+		break;
+	case OP_SIZE:
+		r->result = pq_size(fc->pq);
+		break;
+	}
+}
+
+static void done(FC_RECORD *r){
+	atomic_store_explicit(&r->state, FC_DONE, memory_order_release);
+}
+
+//answers every pending slot; caller holds the combiner lock
+static void combine(FC *fc){
+	FC_RECORD *ins[FC_SLOTS], *del[FC_SLOTS];
+	int ni = 0, nd = 0;
+	int i, j, best, top_id;
+	double top;
+
+	for(i = 0; i < FC_SLOTS; i++){
+		FC_RECORD *r = &fc->slots[i];
+		if(atomic_load_explicit(&r->state, memory_order_acquire) != FC_PENDING)
+			continue;
+		if(r->op == OP_INSERT)
+			ins[ni++] = r;
+		else if(r->op == OP_DELETE)
+			del[nd++] = r;
+		else {
+			apply(fc, r);
+			done(r);
+		}
+	}
+
+	//fuse each delete with the best pending insert that beats the top
+	for(i = 0; i < nd; i++){
+		best = -1;
+		for(j = 0; j < ni; j++){
+			if(ins[j] == NULL || ins[j]->id < 0 || pq_capacity(fc->pq) <= ins[j]->id || pq_contains(fc->pq, ins[j]->id))
+				continue;
+			if(best < 0 || better(fc, ins[j]->priority, ins[best]->priority))
+				best = j;
+		}
+		if(best >= 0 && (pq_size(fc->pq) == 0 || (pq_peek_top(fc->pq, &top_id, &top) && better(fc, ins[best]->priority, top)))){
+			del[i]->id = ins[best]->id;
+			del[i]->priority = ins[best]->priority;
+			del[i]->result = 1;
+			ins[best]->result = 1;
+			done(ins[best]);
+			ins[best] = NULL;
+		}
+		else
+			apply(fc, del[i]);
+		done(del[i]);
+	}
+	for(j = 0; j < ni; j++){
+		if(ins[j] != NULL){
+			apply(fc, ins[j]);
+			done(ins[j]);
+		}
+	}
+}
+
+static FC_RECORD * claim(FC *fc){
+	int i, expected;
+	if(slot_hint < 0)
+		slot_hint = atomic_fetch_add(&next_hint, 1) % FC_SLOTS;
+	for(i = slot_hint; ; i = (i + 1) % FC_SLOTS){
+		expected = FC_FREE;
+		if(atomic_compare_exchange_weak(&fc->slots[i].state, &expected, FC_CLAIMED))
+			return &fc->slots[i];
+		if(i == (slot_hint + FC_SLOTS - 1) % FC_SLOTS)
+			sched_yield();
+	}
+}
+
+//publishes r and waits until it is answered, combining if possible
+static void publish(FC *fc, FC_RECORD *r){
+	int spins = 0, unlocked;
+
+	atomic_store_explicit(&r->state, FC_PENDING, memory_order_release);
+	while(atomic_load_explicit(&r->state, memory_order_acquire) != FC_DONE){
+		unlocked = 0;
+		if(atomic_load_explicit(&fc->lock, memory_order_relaxed) == 0
+				&& atomic_compare_exchange_strong(&fc->lock, &unlocked, 1)){
+			combine(fc);
+			atomic_store_explicit(&fc->lock, 0, memory_order_release);
+		}
+		else if(++spins % FC_SPINS == 0)
+			sched_yield();
+	}
+}
+
+//runs one operation through the combiner and frees the slot
+static int run(FC *fc, int op, int *id, double *priority){
+	FC_RECORD *r = claim(fc);
+	int result;
+
+	r->op = op;
+	r->id = *id;
+	r->priority = *priority;
+	publish(fc, r);
+	*id = r->id;
+	*priority = r->priority;
+	result = r->result;
+	atomic_store_explicit(&r->state, FC_FREE, memory_order_release);
+	return result;
+}
+
+static int fc_insert(void *impl, int id, double priority){
+	return run(impl, OP_INSERT, &id, &priority);
+}
+
+static int fc_change_priority(void *impl, int id, double new_priority){
+	return run(impl, OP_CHANGE, &id, &new_priority);
+}
+
+static int fc_remove_by_id(void *impl, int id){
+	double priority = 0;
+	return run(impl, OP_REMOVE, &id, &priority);
+}
+
+static int fc_get_priority(void *impl, int id, double *priority){
+	return run(impl, OP_GET, &id, priority);
+}
+
+static int fc_delete_top(void *impl, int *id, double *priority){
+	return run(impl, OP_DELETE, id, priority);
+}
+
+static int fc_peek_top(void *impl, int *id, double *priority){
+	return run(impl, OP_PEEK, id, priority);
+}
+
+static int fc_size(void *impl){
+	int id = 0;
+	double priority = 0;
+	return run(impl, OP_SIZE, &id, &priority);
+}
+
+static void fc_free(void *impl){
+	FC *fc = impl;
+	pq_free(fc->pq);
+	free(fc);
+}
+
+static const PQ_ENGINE fc_engine = {
+	fc_insert,
+	fc_change_priority,
+	fc_remove_by_id,
+	fc_get_priority,
+	fc_delete_top,
+	fc_peek_top,
+	fc_size,
+	fc_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_concurrent(int capacity, int min_heap){
+	FC *fc;
+	int i;
+
+	if(posix_memalign((void **)&fc, 64, sizeof(FC)) != 0){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	fc->pq = pq_create(capacity, min_heap);
+	fc->min_heap = min_heap;
+	atomic_init(&fc->lock, 0);
+	for(i = 0; i < FC_SLOTS; i++)
+		atomic_init(&fc->slots[i].state, FC_FREE);
+	return pq_wrap(&fc_engine, fc, capacity, min_heap);
+}
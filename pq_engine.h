@@ -0,0 +1,58 @@
+#ifndef PQ_ENGINE_H
+#define PQ_ENGINE_H
+
+#include "pq.h"
+
+/**
+* Private interface between pq.c and the alternative queue
+* implementations (pq_pairing.c, ...).
+*
+* A queue created by one of the pq_create_* engine functions is a PQ
+* whose calls pq.c forwards to the engine's operations.  impl is the
+* engine's own state; the operations have the same contract as the
+* matching pq.h functions.  pq.c keeps the capacity and min/max flag,
+* everything else belongs to the engine.
+*
+* The operations after free are optional and NULL for engines that do
+* not have them; pq.c reports the call as unsupported.  Engine tables
+* spell out every field, NULLs included, so a table that misses a newly
+* added field shows up under -Wmissing-field-initializers.
+**/
+typedef struct pq_engine {
+	int (*insert)(void *impl, int id, double priority);
+	int (*change_priority)(void *impl, int id, double new_priority);
+	int (*remove_by_id)(void *impl, int id);
+	int (*get_priority)(void *impl, int id, double *priority);
+	int (*delete_top)(void *impl, int *id, double *priority);
+	int (*peek_top)(void *impl, int *id, double *priority);
+	int (*size)(void *impl);
+	void (*free)(void *impl);
+	int (*peek_bottom)(void *impl, int *id, double *priority);
+	int (*delete_bottom)(void *impl, int *id, double *priority);
+	//moves every entry of other (state of the same engine) into impl;
+	//fails, changing neither, if one of its ids is out of impl's range
+	//or already in impl
+	int (*merge)(void *impl, void *other);
+} PQ_ENGINE;
+
+/**
+* Function: pq_wrap
+* Parameters: engine - operations of the implementation
+*             impl - its state, released through engine->free
+*             capacity, min_heap - as passed to the engine's create
+* Returns:  PQ whose calls are forwarded to engine
+*
+*/
+extern PQ * pq_wrap(const PQ_ENGINE *engine, void *impl, int capacity, int min_heap);
+
+/**
+* Function: pq_contains
+* Parameters: priority queue pq, element id
+* Returns: 1 if there is an entry for id, 0 otherwise (also for ids out
+*          of range).  Unlike pq_get_priority, a miss on an array
+*          heap queue is not reported.
+*
+*/
+extern int pq_contains(PQ * pq, int id);
+
+#endif
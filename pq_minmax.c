@@ -0,0 +1,252 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* min-max heap engine: one array heap that gives access to both ends.
+ * levels alternate between "top" levels (the root's, even depth) and
+ * "bottom" levels: an entry on a top level is at or ahead of everything
+ * below it, one on a bottom level at or behind everything below it. so
+ * the top is the root and the bottom is the worse of its two children.
+ *
+ * entries are stored as keys, the priority negated for a max-heap, so
+ * the top levels always hold the smaller keys. priorities, ids and the
+ * id -> index map are parallel arrays as in pq.c.
+ *
+ * an entry moves on levels of its own kind two steps at a time, so a
+ * sift is about log2(n) / 2 moves, each looking at up to four
+ * grandchildren on the way down.
+ */
+
+#define TOP_LEVEL(i)	(__builtin_clz(i) & 1)	//depth of i (1-based) is even
+
+typedef struct minmax_struct {
+	double *key;	//priority, negated for a max-heap; index 0 unused
+	int *ids;
+	int *pos;		//heap index of every id, 0 if absent
+	int size;
+	int capacity;
+	double sign;	//1 for a min-heap, -1 for a max-heap
+} MINMAX;
+
+
+//whether key a belongs nearer the root than b, on a top (or bottom) level
+static inline int ahead(int top, double a, double b){
+	return top ? a < b : a > b;
+}
+
+static inline void put(MINMAX *h, int i, double key, int id){
+	h->key[i] = key;
+	h->ids[i] = id;
+	h->pos[id] = i;
+}
+
+static void bubble_up(MINMAX *h, int i){
+	double x = h->key[i];
+	int d = h->ids[i];
+	int top = TOP_LEVEL(i);
+
+	//behind its parent: it belongs on the parent's kind of level
+	if(i > 1 && ahead(!top, x, h->key[i / 2])){
+		put(h, i, h->key[i / 2], h->ids[i / 2]);
+		i /= 2;
+		top = !top;
+	}
+	while(i > 3 && ahead(top, x, h->key[i / 4])){
+		put(h, i, h->key[i / 4], h->ids[i / 4]);
+		i /= 4;
+	}
+	put(h, i, x, d);
+}
+
+/* sinks the entry at i below the entries that belong ahead of it and
+ * returns where it came to rest. on the way it may be traded with an
+ * entry of the other kind, which then sinks on in its place.
+ */
+static int trickle_down(MINMAX *h, int i){
+	double x = h->key[i], y;
+	int d = h->ids[i], e;
+	int top = TOP_LEVEL(i), rest = 0, c, m, g, end;
+
+	while((c = 2 * i) <= h->size){
+		//m is the best of i's children and grandchildren
+		m = c;
+		if(c + 1 <= h->size && ahead(top, h->key[c + 1], h->key[m]))
+			m = c + 1;
+		end = 2 * c + 3 <= h->size ? 2 * c + 3 : h->size;
+		for(g = 2 * c; g <= end; g++)
+			if(ahead(top, h->key[g], h->key[m]))
+				m = g;
+		if(!ahead(top, h->key[m], x))
+			break;
+		put(h, i, h->key[m], h->ids[m]);
+		i = m;
+		if(m <= c + 1)
+			break;	//a child; everything below it is behind x
+		if(ahead(top, h->key[m / 2], x)){
+			y = h->key[m / 2];
+			e = h->ids[m / 2];
+			put(h, m / 2, x, d);
+			if(rest == 0)
+				rest = m / 2;
+			x = y;
+			d = e;
+		}
+	}
+	put(h, i, x, d);
+	return rest != 0 ? rest : i;
+}
+
+//puts a changed entry at i back in order
+static void settle(MINMAX *h, int i){
+	bubble_up(h, trickle_down(h, i));
+}
+
+static void remove_at(MINMAX *h, int i){
+	int last = h->size--;
+	h->pos[h->ids[i]] = 0;
+	if(i == last)
+		return;
+	put(h, i, h->key[last], h->ids[last]);
+	settle(h, i);
+}
+
+//index of the bottom entry of a non-empty heap
+static int bottom(MINMAX *h){
+	if(h->size < 3)
+		return h->size;
+	return h->key[3] > h->key[2] ? 3 : 2;
+}
+
+static int in_queue(MINMAX *h, int id){
+	return id >= 0 && id < h->capacity && h->pos[id] != 0;
+}
+
+static int minmax_insert(void *impl, int id, double priority){
+	MINMAX *h = impl;
+	if(id < 0 || h->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(h->pos[id] != 0){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	put(h, ++h->size, h->sign * priority, id);
+	bubble_up(h, h->size);
+	return 1;
+}
+
+static int minmax_change_priority(void *impl, int id, double new_priority){
+	MINMAX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	h->key[h->pos[id]] = h->sign * new_priority;
+	settle(h, h->pos[id]);
+	return 1;
+}
+
+static int minmax_remove_by_id(void *impl, int id){
+	MINMAX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	remove_at(h, h->pos[id]);
+	return 1;
+}
+
+static int minmax_get_priority(void *impl, int id, double *priority){
+	MINMAX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = h->sign * h->key[h->pos[id]];
+	return 1;
+}
+
+static int minmax_peek_top(void *impl, int *id, double *priority){
+	MINMAX *h = impl;
+	if(h->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	*id = h->ids[1];
+	*priority = h->sign * h->key[1];
+	return 1;
+}
+
+static int minmax_delete_top(void *impl, int *id, double *priority){
+	MINMAX *h = impl;
+	if(!minmax_peek_top(impl, id, priority))
+		return 0;
+	remove_at(h, 1);
+	return 1;
+}
+
+static int minmax_peek_bottom(void *impl, int *id, double *priority){
+	MINMAX *h = impl;
+	if(h->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	*id = h->ids[bottom(h)];
+	*priority = h->sign * h->key[bottom(h)];
+	return 1;
+}
+
+static int minmax_delete_bottom(void *impl, int *id, double *priority){
+	MINMAX *h = impl;
+	if(!minmax_peek_bottom(impl, id, priority))
+		return 0;
+	remove_at(h, bottom(h));
+	return 1;
+}
+
+static int minmax_size(void *impl){
+	return ((MINMAX *)impl)->size;
+}
+
+static void minmax_free(void *impl){
+	MINMAX *h = impl;
+	free(h->key);
+	free(h->ids);
+	free(h->pos);
+	free(h);
+}
+
+static const PQ_ENGINE minmax_engine = {
+	minmax_insert,
+	minmax_change_priority,
+	minmax_remove_by_id,
+	minmax_get_priority,
+	minmax_delete_top,
+	minmax_peek_top,
+	minmax_size,
+	minmax_free,
+	minmax_peek_bottom,
+	minmax_delete_bottom,
+	NULL
+};
+
+PQ * pq_create_minmax(int capacity, int min_heap){
+	MINMAX *h;
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	h = malloc(sizeof(MINMAX));
+	if(h == NULL || (h->key = malloc(sizeof(double) * ((size_t)capacity + 1))) == NULL
+			|| (h->ids = malloc(sizeof(int) * ((size_t)capacity + 1))) == NULL
+			|| (h->pos = calloc(capacity, sizeof(int))) == NULL){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	h->size = 0;
+	h->capacity = capacity;
+	h->sign = min_heap ? 1 : -1;
+	return pq_wrap(&minmax_engine, h, capacity, min_heap);
+}
@@ -0,0 +1,346 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+/* relaxed concurrent engine (MultiQueue). the entries are spread over
+ * many independent array heaps, each behind its own try-lock. an insert
+ * goes to a random sub-queue; delete_top looks at the cached tops of two
+ * random sub-queues and pops from the better one. nothing is ever
+ * globally locked, so throughput grows with the number of threads.
+ *
+ * the price is ordering: delete_top returns an entry near the top
+ * rather than the top itself. with m sub-queues and two choices the
+ * rank of the returned entry (how many better entries were left in the
+ * queue) is O(m) in expectation and O(m log m) with high probability,
+ * independent of the queue size (Alistarh et al., "The Power of Choice
+ * in Priority Scheduling"; Rihani, Sanders, Dementiev, "MultiQueues").
+ * use m = c * threads with a small c (2 to 4).
+ *
+ * a global id -> sub-queue map keeps the id based calls working. inside
+ * a sub-queue, entries use dense local ids so each heap only indexes
+ * the entries it holds.
+ */
+
+#define ABSENT		-1	//owner of an id that is not in the queue
+#define CLAIMED		-2	//owner of an id being inserted
+#define SCAN_AFTER	64	//random picks before delete_top scans every sub-queue
+
+typedef struct sub_queue {
+	PQ *pq;			//array heap keyed by local id
+	int *global;	//global id of every local id
+	int *free_ids;	//released local ids
+	int nfree;
+	int next_local;	//local ids below this have been handed out
+	int room;		//length of global and free_ids
+	_Atomic int lock;
+	_Atomic double top;	//priority at the top, read without the lock
+} __attribute__((aligned(64))) SUB_QUEUE;
+
+typedef struct multiqueue_struct {
+	SUB_QUEUE *queues;
+	int nqueues;
+	_Atomic int *owner;	//sub-queue holding each id, ABSENT or CLAIMED
+	int *local;		//local id of each id inside its sub-queue
+	_Atomic int size;
+	int capacity;
+	int min_heap;
+	double empty;	//top of an empty sub-queue, worse than any priority
+} MULTIQUEUE;
+
+static _Thread_local unsigned long long rng_state;
+static _Atomic unsigned long long rng_seed = 0x9e3779b97f4a7c15ULL;
+
+
+//per-thread xorshift, seeded once per thread
+static int pick(MULTIQUEUE *mq){
+	if(rng_state == 0)
+		rng_state = atomic_fetch_add(&rng_seed, 0x9e3779b97f4a7c15ULL) | 1;
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return (int)(rng_state % mq->nqueues);
+}
+
+static int try_lock(SUB_QUEUE *q){
+	return atomic_load_explicit(&q->lock, memory_order_relaxed) == 0
+		&& atomic_exchange_explicit(&q->lock, 1, memory_order_acquire) == 0;
+}
+
+static void lock(SUB_QUEUE *q){
+	int spins = 0;
+	while(!try_lock(q))
+		if(++spins % 64 == 0)
+			sched_yield();
+}
+
+static void unlock(SUB_QUEUE *q){
+	atomic_store_explicit(&q->lock, 0, memory_order_release);
+}
+
+//republishes the cached top after the sub-queue changed
+static void update_top(MULTIQUEUE *mq, SUB_QUEUE *q){
+	int id;
+	double priority = mq->empty;
+	if(pq_size(q->pq) > 0)
+		pq_peek_top(q->pq, &id, &priority);
+	atomic_store_explicit(&q->top, priority, memory_order_relaxed);
+}
+
+static int better(MULTIQUEUE *mq, double a, double b){
+	return mq->min_heap ? a < b : a > b;
+}
+
+/* hands out a local id, doubling the sub-queue's room (never past
+ * capacity: a sub-queue cannot hold more entries than the whole queue)
+ */
+static int alloc_local(SUB_QUEUE *q, int capacity){
+	if(q->nfree > 0)
+		return q->free_ids[--q->nfree];
+	if(q->next_local == q->room){
+		q->room = q->room < capacity / 2 ? 2 * q->room : capacity;
+		q->global = realloc(q->global, sizeof(int) * q->room);
+		q->free_ids = realloc(q->free_ids, sizeof(int) * q->room);
+		if(q->global == NULL || q->free_ids == NULL){
+			printf("ERROR: Out of memory!\n");
+			exit(1);
+		}
+		if(!pq_reserve(q->pq, q->room))
+			exit(1);
+	}
+	return q->next_local++;
+}
+
+/* locks the sub-queue holding id and returns its index, or -1 if id is
+ * not in the queue. retries if the entry moves while waiting.
+ */
+static int lock_owner(MULTIQUEUE *mq, int id){
+	int s;
+	for(;;){
+		s = atomic_load_explicit(&mq->owner[id], memory_order_acquire);
+		if(s == ABSENT)
+			return -1;
+		if(s == CLAIMED){
+			sched_yield();
+			continue;
+		}
+		lock(&mq->queues[s]);
+		if(atomic_load_explicit(&mq->owner[id], memory_order_relaxed) == s)
+			return s;
+		unlock(&mq->queues[s]);
+	}
+}
+
+static int mq_insert(void *impl, int id, double priority){
+	MULTIQUEUE *mq = impl;
+	int expected = ABSENT;
+	SUB_QUEUE *q;
+	int s, l;
+
+	if(id < 0 || mq->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(!atomic_compare_exchange_strong(&mq->owner[id], &expected, CLAIMED)){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	do
+		s = pick(mq);
+	while(!try_lock(&mq->queues[s]));
+	q = &mq->queues[s];
+	l = alloc_local(q, mq->capacity);
+	q->global[l] = id;
+	mq->local[id] = l;
+	pq_insert(q->pq, l, priority);
+	update_top(mq, q);
+	atomic_store_explicit(&mq->owner[id], s, memory_order_release);
+	unlock(q);
+	atomic_fetch_add(&mq->size, 1);
+	return 1;
+}
+
+static int mq_change_priority(void *impl, int id, double new_priority){
+	MULTIQUEUE *mq = impl;
+	int s;
+	if(id < 0 || mq->capacity <= id || (s = lock_owner(mq, id)) < 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	pq_change_priority(mq->queues[s].pq, mq->local[id], new_priority);
+	update_top(mq, &mq->queues[s]);
+	unlock(&mq->queues[s]);
+	return 1;
+}
+
+//takes local id l out of locked sub-queue q; the caller already removed it from the heap
+static void release(MULTIQUEUE *mq, SUB_QUEUE *q, int l){
+	int id = q->global[l];
+	q->free_ids[q->nfree++] = l;
+	update_top(mq, q);
+	atomic_store_explicit(&mq->owner[id], ABSENT, memory_order_release);
+	atomic_fetch_sub(&mq->size, 1);
+}
+
+static int mq_remove_by_id(void *impl, int id){
+	MULTIQUEUE *mq = impl;
+	int s;
+	if(id < 0 || mq->capacity <= id || (s = lock_owner(mq, id)) < 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	pq_remove_by_id(mq->queues[s].pq, mq->local[id]);
+	release(mq, &mq->queues[s], mq->local[id]);
+	unlock(&mq->queues[s]);
+	return 1;
+}
+
+static int mq_get_priority(void *impl, int id, double *priority){
+	MULTIQUEUE *mq = impl;
+	int s;
+	if(id < 0 || mq->capacity <= id || (s = lock_owner(mq, id)) < 0){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	pq_get_priority(mq->queues[s].pq, mq->local[id], priority);
+	unlock(&mq->queues[s]);
+	return 1;
+}
+
+/* locks a non-empty sub-queue with a good top: the better of two random
+ * picks, or after SCAN_AFTER misses the best of all of them. returns -1
+ * once the whole queue is empty.
+ */
+static int lock_near_top(MULTIQUEUE *mq){
+	int tries = 0;
+	int s, t, i;
+	for(;;){
+		if(atomic_load(&mq->size) == 0)
+			return -1;
+		if(++tries < SCAN_AFTER){
+			s = pick(mq);
+			t = pick(mq);
+			if(better(mq, atomic_load_explicit(&mq->queues[t].top, memory_order_relaxed),
+					atomic_load_explicit(&mq->queues[s].top, memory_order_relaxed)))
+				s = t;
+		}
+		else {
+			s = 0;
+			for(i = 1; i < mq->nqueues; i++)
+				if(better(mq, atomic_load_explicit(&mq->queues[i].top, memory_order_relaxed),
+						atomic_load_explicit(&mq->queues[s].top, memory_order_relaxed)))
+					s = i;
+			sched_yield();
+		}
+		if(!try_lock(&mq->queues[s]))
+			continue;
+		if(pq_size(mq->queues[s].pq) > 0)
+			return s;
+		unlock(&mq->queues[s]);
+	}
+}
+
+static int mq_delete_top(void *impl, int *id, double *priority){
+	MULTIQUEUE *mq = impl;
+	int s = lock_near_top(mq);
+	int l;
+	if(s < 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	pq_delete_top(mq->queues[s].pq, &l, priority);
+	*id = mq->queues[s].global[l];
+	release(mq, &mq->queues[s], l);
+	unlock(&mq->queues[s]);
+	return 1;
+}
+
+static int mq_peek_top(void *impl, int *id, double *priority){
+	MULTIQUEUE *mq = impl;
+	int s = lock_near_top(mq);
+	int l;
+	if(s < 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	pq_peek_top(mq->queues[s].pq, &l, priority);
+	*id = mq->queues[s].global[l];
+	unlock(&mq->queues[s]);
+	return 1;
+}
+
+static int mq_size(void *impl){
+	return atomic_load(&((MULTIQUEUE *)impl)->size);
+}
+
+static void mq_free(void *impl){
+	MULTIQUEUE *mq = impl;
+	int i;
+	for(i = 0; i < mq->nqueues; i++){
+		pq_free(mq->queues[i].pq);
+		free(mq->queues[i].global);
+		free(mq->queues[i].free_ids);
+	}
+	free(mq->queues);
+	free(mq->owner);
+	free(mq->local);
+	free(mq);
+}
+
+static const PQ_ENGINE multiqueue_engine = {
+	mq_insert,
+	mq_change_priority,
+	mq_remove_by_id,
+	mq_get_priority,
+	mq_delete_top,
+	mq_peek_top,
+	mq_size,
+	mq_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_multiqueue(int capacity, int min_heap, int nqueues){
+	MULTIQUEUE *mq;
+	int i, room;
+
+	if(0 >= capacity || 0 >= nqueues){
+		printf("Capacity and number of queues must be greater than 0!\n");
+		exit(1);
+	}
+	mq = malloc(sizeof(MULTIQUEUE));
+	if(posix_memalign((void **)&mq->queues, 64, sizeof(SUB_QUEUE) * nqueues) != 0){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	mq->nqueues = nqueues;
+	mq->owner = malloc(sizeof(*mq->owner) * capacity);
+	mq->local = malloc(sizeof(int) * capacity);
+	for(i = 0; i < capacity; i++)
+		atomic_init(&mq->owner[i], ABSENT);
+	atomic_init(&mq->size, 0);
+	mq->capacity = capacity;
+	mq->min_heap = min_heap;
+	mq->empty = min_heap ? INFINITY : -INFINITY;
+
+	//sub-queues grow with their share of the entries. they are fixed
+	//queues grown by alloc_local: a growable one would reserve address
+	//space for PQ_MAX_CAPACITY ids apiece
+	room = capacity / nqueues + 1;
+	for(i = 0; i < nqueues; i++){
+		SUB_QUEUE *q = &mq->queues[i];
+		q->pq = pq_create(room, min_heap);
+		q->global = malloc(sizeof(int) * room);
+		q->free_ids = malloc(sizeof(int) * room);
+		q->nfree = 0;
+		q->next_local = 0;
+		q->room = room;
+		atomic_init(&q->lock, 0);
+		atomic_init(&q->top, mq->empty);
+	}
+	return pq_wrap(&multiqueue_engine, mq, capacity, min_heap);
+}
@@ -0,0 +1,294 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pairing heap engine. every id owns a node in an array indexed by id;
+ * the tree is threaded through child/sibling/prev indices, where prev is
+ * the parent for a leftmost child and the left sibling otherwise.
+ *
+ * a max-heap stores negated priorities so the code only ever needs "<".
+ */
+
+#define NIL		-1	//no node
+#define ABSENT	-2	//prev of an id that is not in the queue
+
+typedef struct pairing_node {
+	double priority;	//stored priority (negated for max-heaps)
+	int child;		//leftmost child
+	int sibling;	//next sibling to the right
+	int prev;		//parent or left sibling, NIL for the root
+} PAIRING_NODE;
+
+typedef struct pairing_struct {
+	PAIRING_NODE *nodes;	//one node per id
+	int root;
+	int size;
+	int capacity;
+	double sign;	//1 for a min-heap, -1 for a max-heap
+} PAIRING;
+
+
+//makes the root with the worse priority the leftmost child of the other
+static int link(PAIRING *h, int a, int b){
+	PAIRING_NODE *n = h->nodes;
+	if(n[b].priority < n[a].priority){
+		int t = a;
+		a = b;
+		b = t;
+	}
+	n[b].sibling = n[a].child;
+	if(n[a].child != NIL)
+		n[n[a].child].prev = b;
+	n[b].prev = a;
+	n[a].child = b;
+	return a;
+}
+
+//detaches the subtree rooted at x from its parent and siblings
+static void cut(PAIRING *h, int x){
+	PAIRING_NODE *n = h->nodes;
+	int prev = n[x].prev;
+	if(n[prev].child == x)
+		n[prev].child = n[x].sibling;
+	else
+		n[prev].sibling = n[x].sibling;
+	if(n[x].sibling != NIL)
+		n[n[x].sibling].prev = prev;
+	n[x].prev = NIL;
+	n[x].sibling = NIL;
+}
+
+/* two-pass pairing of the sibling list starting at first: link pairs
+ * left to right, then fold the results right to left. returns the new
+ * tree, NIL if the list was empty.
+ */
+static int merge_pairs(PAIRING *h, int first){
+	PAIRING_NODE *n = h->nodes;
+	int a, b, next, list = NIL;
+
+	if(first == NIL)
+		return NIL;
+	//first pass, each linked pair is pushed onto list through sibling
+	while(first != NIL){
+		a = first;
+		b = n[a].sibling;
+		next = NIL;
+		if(b != NIL){
+			next = n[b].sibling;
+			n[b].sibling = NIL;
+			a = link(h, a, b);
+		}
+		n[a].sibling = list;
+		list = a;
+		first = next;
+	}
+	//second pass, the list is already in right to left order
+	a = list;
+	list = n[a].sibling;
+	n[a].sibling = NIL;
+	while(list != NIL){
+		b = list;
+		list = n[b].sibling;
+		n[b].sibling = NIL;
+		a = link(h, a, b);
+	}
+	n[a].prev = NIL;
+	return a;
+}
+
+//takes x out of the heap; its children are paired and linked back in
+static void unlink_node(PAIRING *h, int x){
+	int rest;
+	if(x == h->root){
+		h->root = merge_pairs(h, h->nodes[x].child);
+	}
+	else {
+		cut(h, x);
+		rest = merge_pairs(h, h->nodes[x].child);
+		if(rest != NIL)
+			h->root = link(h, h->root, rest);
+	}
+	h->nodes[x].prev = ABSENT;
+	h->size--;
+}
+
+//adds x as a single node tree
+static void push_node(PAIRING *h, int x, double priority){
+	PAIRING_NODE *n = h->nodes;
+	n[x].priority = priority;
+	n[x].child = NIL;
+	n[x].sibling = NIL;
+	n[x].prev = NIL;
+	h->root = (h->root == NIL) ? x : link(h, h->root, x);
+	h->size++;
+}
+
+static int in_queue(PAIRING *h, int id){
+	return id >= 0 && id < h->capacity && h->nodes[id].prev != ABSENT;
+}
+
+static int pairing_insert(void *impl, int id, double priority){
+	PAIRING *h = impl;
+	if(id < 0 || h->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(h->nodes[id].prev != ABSENT){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	push_node(h, id, h->sign * priority);
+	return 1;
+}
+
+static int pairing_change_priority(void *impl, int id, double new_priority){
+	PAIRING *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	double priority = h->sign * new_priority;
+	PAIRING_NODE *x = &h->nodes[id];
+
+	//decrease-key: cut the subtree and link it back at the root, O(1)
+	if(priority <= x->priority){
+		x->priority = priority;
+		if(id != h->root){
+			cut(h, id);
+			h->root = link(h, h->root, id);
+		}
+	}
+	//increase-key: the children may now be out of order, reinsert
+	else {
+		unlink_node(h, id);
+		push_node(h, id, priority);
+	}
+	return 1;
+}
+
+static int pairing_remove_by_id(void *impl, int id){
+	PAIRING *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	unlink_node(h, id);
+	return 1;
+}
+
+static int pairing_get_priority(void *impl, int id, double *priority){
+	PAIRING *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = h->sign * h->nodes[id].priority;
+	return 1;
+}
+
+static int pairing_peek_top(void *impl, int *id, double *priority){
+	PAIRING *h = impl;
+	if(h->root == NIL){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	*id = h->root;
+	*priority = h->sign * h->nodes[h->root].priority;
+	return 1;
+}
+
+static int pairing_delete_top(void *impl, int *id, double *priority){
+	PAIRING *h = impl;
+	if(!pairing_peek_top(impl, id, priority))
+		return 0;
+	unlink_node(h, h->root);
+	return 1;
+}
+
+//node after x in preorder within the tree rooted at root, NIL at the end
+static int next_node(PAIRING *h, int root, int x){
+	PAIRING_NODE *n = h->nodes;
+	if(n[x].child != NIL)
+		return n[x].child;
+	while(x != root){
+		if(n[x].sibling != NIL)
+			return n[x].sibling;
+		//back over the left siblings to the leftmost child, whose prev is the parent
+		while(n[n[x].prev].child != x)
+			x = n[x].prev;
+		x = n[x].prev;
+	}
+	return NIL;
+}
+
+/* moves every node of other into h: nodes are indexed by id in both, so
+ * they are copied across as they are and the two roots linked, with no
+ * pairing passes. O(size of other).
+ */
+static int pairing_merge(void *impl, void *other){
+	PAIRING *h = impl, *o = other;
+	int x;
+	for(x = o->root; x != NIL; x = next_node(o, o->root, x)){
+		if(h->capacity <= x){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		if(h->nodes[x].prev != ABSENT){
+			printf("ERROR: ID is already occupied at the given position.\n");
+			return 0;
+		}
+	}
+	if(o->root == NIL)
+		return 1;
+	for(x = o->root; x != NIL; x = next_node(o, o->root, x))
+		h->nodes[x] = o->nodes[x];
+	for(x = o->root; x != NIL; x = next_node(h, o->root, x))
+		o->nodes[x].prev = ABSENT;
+	h->root = (h->root == NIL) ? o->root : link(h, h->root, o->root);
+	h->size += o->size;
+	o->root = NIL;
+	o->size = 0;
+	return 1;
+}
+
+static int pairing_size(void *impl){
+	return ((PAIRING *)impl)->size;
+}
+
+static void pairing_free(void *impl){
+	PAIRING *h = impl;
+	free(h->nodes);
+	free(h);
+}
+
+static const PQ_ENGINE pairing_engine = {
+	pairing_insert,
+	pairing_change_priority,
+	pairing_remove_by_id,
+	pairing_get_priority,
+	pairing_delete_top,
+	pairing_peek_top,
+	pairing_size,
+	pairing_free,
+	NULL,
+	NULL,
+	pairing_merge
+};
+
+PQ * pq_create_pairing(int capacity, int min_heap){
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	PAIRING *h = malloc(sizeof(PAIRING));
+	h->nodes = malloc(sizeof(PAIRING_NODE) * capacity);
+	int i;
+	for(i = 0; i < capacity; i++)
+		h->nodes[i].prev = ABSENT;
+	h->root = NIL;
+	h->size = 0;
+	h->capacity = capacity;
+	h->sign = min_heap ? 1 : -1;
+	return pq_wrap(&pairing_engine, h, capacity, min_heap);
+}
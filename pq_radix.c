@@ -0,0 +1,258 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* monotone radix heap engine. priorities are mapped to 64-bit keys that
+ * sort like the doubles they came from; an entry lives in bucket
+ * 64 - clz(key ^ last) where last is the key most recently taken off
+ * the top (bucket 0 holds keys equal to last). delete_top only has to
+ * scan the lowest non-empty bucket and spread it over the lower ones,
+ * and each key can move down at most 64 times over its lifetime.
+ *
+ * this only works while no key below last is ever inserted, so such
+ * inserts and priority changes are rejected. once the queue is empty
+ * no bucket depends on last, so it goes back to 0 and any key is taken.
+ *
+ * every bucket is a doubly linked list threaded through an array
+ * indexed by id, which gives O(1) remove_by_id and priority changes.
+ */
+
+#define NIL			-1
+#define BUCKETS		65
+#define ABSENT		-1	//bucket of an id that is not in the queue
+
+typedef struct radix_node {
+	uint64_t key;
+	int prev;
+	int next;
+	int bucket;
+} RADIX_NODE;
+
+typedef struct radix_struct {
+	RADIX_NODE *nodes;		//one node per id
+	int head[BUCKETS];		//first id in each bucket
+	uint64_t nonempty;		//bit b-1 set when bucket b (1..64) is non-empty
+	uint64_t last;			//key of the last entry taken off the top
+	int size;
+	int capacity;
+	double sign;			//1 for a min-heap, -1 for a max-heap
+} RADIX;
+
+
+//order preserving double -> unsigned mapping (negatives flipped below positives)
+static uint64_t encode(double priority){
+	uint64_t u;
+	if(priority == 0)
+		priority = 0;	//treat -0.0 like 0.0
+	memcpy(&u, &priority, sizeof(u));
+	return (u >> 63) ? ~u : u | ((uint64_t)1 << 63);
+}
+
+static double decode(uint64_t key){
+	double priority;
+	key = (key >> 63) ? key & ~((uint64_t)1 << 63) : ~key;
+	memcpy(&priority, &key, sizeof(key));
+	return priority;
+}
+
+static int bucket_of(RADIX *h, uint64_t key){
+	return key == h->last ? 0 : 64 - __builtin_clzll(key ^ h->last);
+}
+
+static void push(RADIX *h, int id){
+	RADIX_NODE *n = &h->nodes[id];
+	int b = bucket_of(h, n->key);
+	n->bucket = b;
+	n->prev = NIL;
+	n->next = h->head[b];
+	if(n->next != NIL)
+		h->nodes[n->next].prev = id;
+	h->head[b] = id;
+	if(b > 0)
+		h->nonempty |= (uint64_t)1 << (b - 1);
+}
+
+static void unlink_node(RADIX *h, int id){
+	RADIX_NODE *n = &h->nodes[id];
+	if(n->prev != NIL)
+		h->nodes[n->prev].next = n->next;
+	else {
+		h->head[n->bucket] = n->next;
+		if(n->next == NIL && n->bucket > 0)
+			h->nonempty &= ~((uint64_t)1 << (n->bucket - 1));
+	}
+	if(n->next != NIL)
+		h->nodes[n->next].prev = n->prev;
+	n->bucket = ABSENT;
+}
+
+/* makes bucket 0 non-empty (queue must be non-empty): the lowest
+ * non-empty bucket's minimum becomes last and the bucket is spread
+ * over the lower buckets.
+ */
+static void refill(RADIX *h){
+	int b, id, next;
+	uint64_t min;
+
+	if(h->head[0] != NIL)
+		return;
+	b = __builtin_ctzll(h->nonempty) + 1;
+	min = h->nodes[h->head[b]].key;
+	for(id = h->head[b]; id != NIL; id = h->nodes[id].next)
+		if(h->nodes[id].key < min)
+			min = h->nodes[id].key;
+	h->last = min;
+	id = h->head[b];
+	h->head[b] = NIL;
+	h->nonempty &= ~((uint64_t)1 << (b - 1));
+	for(; id != NIL; id = next){
+		next = h->nodes[id].next;
+		push(h, id);
+	}
+}
+
+static int in_queue(RADIX *h, int id){
+	return id >= 0 && id < h->capacity && h->nodes[id].bucket != ABSENT;
+}
+
+static int radix_insert(void *impl, int id, double priority){
+	RADIX *h = impl;
+	if(id < 0 || h->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(h->nodes[id].bucket != ABSENT){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	uint64_t key = encode(h->sign * priority);
+	if(key < h->last){
+		printf("ERROR: Priority is behind the last top of a monotone queue.\n");
+		return 0;
+	}
+	h->nodes[id].key = key;
+	push(h, id);
+	h->size++;
+	return 1;
+}
+
+static int radix_change_priority(void *impl, int id, double new_priority){
+	RADIX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	uint64_t key = encode(h->sign * new_priority);
+	if(key < h->last){
+		printf("ERROR: Priority is behind the last top of a monotone queue.\n");
+		return 0;
+	}
+	unlink_node(h, id);
+	h->nodes[id].key = key;
+	push(h, id);
+	return 1;
+}
+
+static int radix_remove_by_id(void *impl, int id){
+	RADIX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	unlink_node(h, id);
+	if(--h->size == 0)
+		h->last = 0;	//an empty queue takes any priority again
+	return 1;
+}
+
+static int radix_get_priority(void *impl, int id, double *priority){
+	RADIX *h = impl;
+	if(!in_queue(h, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = h->sign * decode(h->nodes[id].key);
+	return 1;
+}
+
+/* peeking must not move last (inserts between the last top and the
+ * current minimum are still legal), so it only scans the lowest
+ * non-empty bucket.
+ */
+static int radix_peek_top(void *impl, int *id, double *priority){
+	RADIX *h = impl;
+	int b, i;
+	if(h->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	b = h->head[0] != NIL ? 0 : __builtin_ctzll(h->nonempty) + 1;
+	*id = h->head[b];
+	for(i = h->head[b]; i != NIL; i = h->nodes[i].next)
+		if(h->nodes[i].key < h->nodes[*id].key)
+			*id = i;
+	*priority = h->sign * decode(h->nodes[*id].key);
+	return 1;
+}
+
+static int radix_delete_top(void *impl, int *id, double *priority){
+	RADIX *h = impl;
+	if(h->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	refill(h);
+	*id = h->head[0];
+	*priority = h->sign * decode(h->last);
+	unlink_node(h, *id);
+	if(--h->size == 0)
+		h->last = 0;
+	return 1;
+}
+
+static int radix_size(void *impl){
+	return ((RADIX *)impl)->size;
+}
+
+static void radix_free(void *impl){
+	RADIX *h = impl;
+	free(h->nodes);
+	free(h);
+}
+
+static const PQ_ENGINE radix_engine = {
+	radix_insert,
+	radix_change_priority,
+	radix_remove_by_id,
+	radix_get_priority,
+	radix_delete_top,
+	radix_peek_top,
+	radix_size,
+	radix_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_radix(int capacity, int min_heap){
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	RADIX *h = malloc(sizeof(RADIX));
+	h->nodes = malloc(sizeof(RADIX_NODE) * capacity);
+	int i;
+	for(i = 0; i < capacity; i++)
+		h->nodes[i].bucket = ABSENT;
+	for(i = 0; i < BUCKETS; i++)
+		h->head[i] = NIL;
+	h->nonempty = 0;
+	h->last = 0;
+	h->size = 0;
+	h->capacity = capacity;
+	h->sign = min_heap ? 1 : -1;
+	return pq_wrap(&radix_engine, h, capacity, min_heap);
+}
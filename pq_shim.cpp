@@ -0,0 +1,393 @@
+#include "pq.h"
+#include "pq.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/* the pq.h interface on top of IndexedPriorityQueue (pq.hpp). link
+ * pq_shim.o in place of pq.o and existing callers run the template code
+ * unchanged: the min/max choice is made once per call here instead of
+ * once per level inside the sift loops. messages and return values are
+ * the ones pq.c gives.
+ *
+ * covers the array heap queues (pq_create, pq_create_growable). every
+ * other pq.h entry point is defined too, so callers still link, but
+ * the ones the template has no counterpart for fail as documented for
+ * a failed call: top-K (pq_create_topk, pq_offer), lazy removal, the
+ * bottom end, queue images (pq_save, pq_open_mapped, pq_open_shm) and
+ * regions (pq_footprint, pq_create_in). the engine queues
+ * (pq_create_pairing, ...) are built on pq.c and still need pq.o.
+ * -DPQ_ARITY picks the arity as for pq.c.
+ */
+
+#ifndef PQ_ARITY
+#define PQ_ARITY 2
+#endif
+
+#ifndef PQ_MAX_CAPACITY
+#define PQ_MAX_CAPACITY (1 << 28)
+#endif
+
+typedef IndexedPriorityQueue<int, double, std::less<double>, PQ_ARITY> MIN_QUEUE;
+typedef IndexedPriorityQueue<int, double, std::greater<double>, PQ_ARITY> MAX_QUEUE;
+
+struct pq_struct {
+	MIN_QUEUE *min;	//exactly one of min and max is set
+	MAX_QUEUE *max;
+	int growable;
+};
+
+//calls f with whichever queue pq holds
+template <class F>
+static auto with(PQ *pq, F f) -> decltype(f(*pq->min)){
+	return pq->min != NULL ? f(*pq->min) : f(*pq->max);
+}
+
+static PQ * create(int capacity, int min_heap, int growable){
+	PQ *p = new PQ;
+	p->min = min_heap ? new MIN_QUEUE(capacity) : NULL;
+	p->max = min_heap ? NULL : new MAX_QUEUE(capacity);
+	p->growable = growable;
+	return p;
+}
+
+/* makes id valid: 1 if it already is or the queue could grow to it,
+ * otherwise 0.
+ */
+static int fits(PQ *pq, int id){
+	if(id < 0)
+		return 0;
+	if(id < pq_capacity(pq))
+		return 1;
+	if(!pq->growable || PQ_MAX_CAPACITY <= id)
+		return 0;
+	with(pq, [&](auto &q){ q.reserve(id + 1); });
+	return 1;
+}
+
+extern "C" {
+
+PQ * pq_create(int capacity, int min_heap){
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	return create(capacity, min_heap, 0);
+}
+
+PQ * pq_create_growable(int capacity, int min_heap){
+	if(0 >= capacity || PQ_MAX_CAPACITY < capacity){
+		printf("Capacity must be between 1 and %d!\n", PQ_MAX_CAPACITY);
+		exit(1);
+	}
+	return create(capacity, min_heap, 1);
+}
+
+//pq_offer is pq.c only
+PQ * pq_create_topk(int capacity, int min_heap, int k){
+	(void)capacity;
+	(void)min_heap;
+	(void)k;
+	printf("ERROR: Top-K queues need pq.o.\n");
+	exit(1);
+}
+
+//the template's vectors move as they grow, so there is no image or region layout
+size_t pq_footprint(int capacity){
+	(void)capacity;
+	return 0;
+}
+
+PQ * pq_create_in(int capacity, int min_heap, const PQ_REGION *region){
+	(void)capacity;
+	(void)min_heap;
+	(void)region;
+	printf("ERROR: Queue regions need pq.o.\n");
+	return NULL;
+}
+
+int pq_save(PQ * pq, const char *path){
+	(void)pq;
+	(void)path;
+	printf("ERROR: Queue images need pq.o.\n");
+	return 0;
+}
+
+PQ * pq_open_mapped(const char *path, int writable){
+	(void)path;
+	(void)writable;
+	printf("ERROR: Queue images need pq.o.\n");
+	return NULL;
+}
+
+PQ * pq_open_shm(const char *name, int capacity, int min_heap){
+	(void)name;
+	(void)capacity;
+	(void)min_heap;
+	printf("ERROR: Queue images need pq.o.\n");
+	return NULL;
+}
+
+//no queue here is backed by an image, so there is nothing to flush
+int pq_sync(PQ * pq){
+	(void)pq;
+	return 1;
+}
+
+int pq_reserve(PQ * pq, int capacity){
+	if(PQ_MAX_CAPACITY < capacity){
+		printf("ERROR: Capacity is out of Range!\n");
+		return 0;
+	}
+	with(pq, [&](auto &q){ q.reserve(capacity); });
+	return 1;
+}
+
+void pq_free(PQ * pq){
+	delete pq->min;
+	delete pq->max;
+	delete pq;
+}
+
+int pq_insert(PQ * pq, int id, double priority){
+	if(!fits(pq, id)){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(!with(pq, [&](auto &q){ return q.insert(id, priority); })){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_capacity(PQ * pq){
+	return with(pq, [](auto &q){ return q.capacity(); });
+}
+
+int pq_size(PQ * pq){
+	return with(pq, [](auto &q){ return (int)q.size(); });
+}
+
+int pq_change_priority(PQ * pq, int id, double new_priority){
+	if(id < 0 || pq_capacity(pq) <= id){
+		printf("ERROR:The value is out of range.\n");
+		return 0;
+	}
+	if(!with(pq, [&](auto &q){ return q.change_priority(id, new_priority); })){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_change_priorities(PQ * pq, const int *ids, const double *new_priorities, int n){
+	int i, changed = 0;
+	for(i = 0; i < n; i++)
+		changed += pq_change_priority(pq, ids[i], new_priorities[i]);
+	return changed;
+}
+
+int pq_remove_by_id(PQ * pq, int id){
+	if(id < 0 || pq_capacity(pq) <= id){
+		printf("ERROR: The value is out of Range!.\n");
+		return 0;
+	}
+	if(!with(pq, [&](auto &q){ return q.remove_by_id(id); })){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_get_priority(PQ * pq, int id, double *priority){
+	if(id < 0 || pq_capacity(pq) <= id){
+		printf("ERROR: The value is out of Range!\n");
+		return 0;
+	}
+	if(!with(pq, [&](auto &q){ return q.get_priority(id, *priority); })){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_delete_top(PQ * pq, int *id, double *priority){
+	if(!with(pq, [&](auto &q){ return q.delete_top(*id, *priority); })){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_delete_top_k(PQ * pq, int k, int *ids, double *priorities){
+	return with(pq, [&](auto &q){
+		int n = 0;
+		while(n < k && q.delete_top(ids[n], priorities[n]))
+			n++;
+		return n;
+	});
+}
+
+int pq_drain_sorted(PQ * pq, int *ids, double *priorities){
+	return pq_delete_top_k(pq, pq_size(pq), ids, priorities);
+}
+
+int pq_peek_top(PQ * pq, int *id, double *priority){
+	if(!with(pq, [&](auto &q){ return q.peek_top(*id, *priority); })){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	return 1;
+}
+
+//the array heap queues have no bottom end
+int pq_peek_bottom(PQ * pq, int *id, double *priority){
+	(void)pq;
+	(void)id;
+	(void)priority;
+	printf("ERROR: The queue has no bottom end.\n");
+	return 0;
+}
+
+int pq_delete_bottom(PQ * pq, int *id, double *priority){
+	return pq_peek_bottom(pq, id, priority);
+}
+
+//the template removes at once
+int pq_set_lazy_remove(PQ * pq, double max_dead){
+	(void)pq;
+	(void)max_dead;
+	printf("ERROR: Lazy removal needs a pq_create or pq_create_growable queue.\n");
+	return 0;
+}
+
+//no queue here has a top-K bound
+int pq_offer(PQ * pq, int id, double priority){
+	(void)pq;
+	(void)id;
+	(void)priority;
+	printf("ERROR: The queue has no top-K bound.\n");
+	return 0;
+}
+
+int pq_offer_bulk(PQ * pq, const int *ids, const double *priorities, int n){
+	int i, taken = 0;
+	for(i = 0; i < n; i++)
+		taken += pq_offer(pq, ids[i], priorities[i]);
+	return taken;
+}
+
+/* pq_merge and pq_split: the template has no slot order to walk, so
+ * src's ids are scanned, checked against dst and only then moved.
+ */
+static int move_entries(PQ *dst, PQ *src, int (*pick)(int id, void *ctx), void *ctx){
+	std::vector<int> ids;
+	std::vector<double> priorities;
+	int id, capacity = pq_capacity(src);
+	double priority;
+	size_t i;
+
+	if(dst == src){
+		printf("ERROR: A queue cannot be merged with itself.\n");
+		return 0;
+	}
+	if((dst->min != NULL) != (src->min != NULL)){
+		printf("ERROR: Both queues must be min-heaps or both max-heaps.\n");
+		return 0;
+	}
+	for(id = 0; id < capacity; id++){
+		if(!with(src, [&](auto &q){ return q.get_priority(id, priority); }) || (pick != NULL && !pick(id, ctx)))
+			continue;
+		if(id >= pq_capacity(dst) && (!dst->growable || PQ_MAX_CAPACITY <= id)){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		if(id < pq_capacity(dst) && with(dst, [&](auto &q){ return q.contains(id); })){
+			printf("ERROR: ID is already occupied at the given position.\n");
+			return 0;
+		}
+		ids.push_back(id);
+		priorities.push_back(priority);
+	}
+	if(ids.empty())
+		return 1;
+	fits(dst, ids.back());
+	with(dst, [&](auto &q){ q.insert_bulk(ids.data(), priorities.data(), ids.size()); });
+	for(i = 0; i < ids.size(); i++)
+		with(src, [&](auto &q){ q.remove_by_id(ids[i]); });
+	return 1;
+}
+
+int pq_merge(PQ * dst, PQ * src){
+	return move_entries(dst, src, NULL, NULL);
+}
+
+int pq_split(PQ * src, PQ * dst, int (*pick)(int id, void *ctx), void *ctx){
+	return move_entries(dst, src, pick, ctx);
+}
+
+//range checks (growing if allowed) before the all-or-nothing batch insert
+static int add_batch(PQ *pq, const int *ids, const double *priorities, int n){
+	int i, max = -1;
+	for(i = 0; i < n; i++){
+		if(ids[i] < 0){
+			printf("ERROR: ID is out of Range!\n");
+			return 0;
+		}
+		if(ids[i] > max)
+			max = ids[i];
+	}
+	if(max >= 0 && !fits(pq, max)){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	if(!with(pq, [&](auto &q){ return q.insert_bulk(ids, priorities, n); })){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	return 1;
+}
+
+int pq_build(PQ * pq, const int *ids, const double *priorities, int n){
+	with(pq, [](auto &q){ q.clear(); });
+	return n >= 0 && add_batch(pq, ids, priorities, n);
+}
+
+int pq_insert_bulk(PQ * pq, const int *ids, const double *priorities, int n){
+	return n >= 0 && add_batch(pq, ids, priorities, n);
+}
+
+//the template builds on one thread
+int pq_build_parallel(PQ * pq, const int *ids, const double *priorities, int n, int threads){
+	(void)threads;
+	return pq_build(pq, ids, priorities, n);
+}
+
+int pq_build_stream(PQ * pq, int (*next)(void *ctx, int *id, double *priority), void *ctx, int threads){
+	std::vector<int> ids;
+	std::vector<double> priorities;
+	int id;
+	double priority;
+
+	(void)threads;
+	while(next(ctx, &id, &priority)){
+		ids.push_back(id);
+		priorities.push_back(priority);
+	}
+	return pq_build(pq, ids.data(), priorities.data(), (int)ids.size());
+}
+
+//the template is not instrumented
+int pq_stats(PQ * pq, PQ_COUNTERS *stats){
+	(void)pq;
+	memset(stats, 0, sizeof(PQ_COUNTERS));
+	return 0;
+}
+
+void pq_stats_reset(PQ * pq){
+	(void)pq;
+}
+
+}
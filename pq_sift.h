@@ -0,0 +1,75 @@
+/* sift-down loop, included by pq.c once per instruction set with
+ *   SIFT_NAME    - name of the function to define
+ *   SIFT_TARGET  - function attributes selecting the instruction set
+ *   SIFT_MIN(p)  - index of the smallest of the PQ_ARITY priorities at p
+ *   SIFT_MAX(p)  - index of the largest of them
+ *
+ * a full block of children goes to SIFT_MIN/SIFT_MAX; the partial block
+ * at the end of the heap is scanned one child at a time. with
+ * track == 0 the pos index is not maintained (heapify fixes it in one
+ * pass afterwards). with -DPQ_STATS each level counts its child
+ * compares plus the one against the sifted entry.
+ */
+SIFT_TARGET static inline void SIFT_NAME(PQ *pq, int i, int track){
+	//hold priority and id temporarily and move the best child up into the hole
+	double x = pq->prio[i];
+	int d = pq->ids[i];
+	int size = pq->size;
+	long child;		//FIRST_CHILD may pass INT_MAX near the bottom
+	int best;
+	STAT(int levels = 0; int compares = 0;)
+
+	//min-heap perc down
+	if(pq->type != 0){
+		while((child = FIRST_CHILD(i)) <= size){
+			//find the min of the children
+			if(child + PQ_ARITY - 1 <= size){
+				best = child + SIFT_MIN(pq->prio + child);
+				STAT(compares += PQ_ARITY;)
+			}
+			else {
+				STAT(compares += size - child + 1;)
+				for(best = child++; child <= size; child++)
+					if(pq->prio[child] < pq->prio[best])
+						best = child;
+			}
+			if(!(pq->prio[best] < x))
+				break;
+			pq->prio[i] = pq->prio[best];
+			pq->ids[i] = pq->ids[best];
+			if(track)
+				pq->pos[pq->ids[i]] = i;
+			i = best;
+			STAT(levels++;)
+		}
+	}
+	// max heap perc down
+	else {
+		while((child = FIRST_CHILD(i)) <= size){
+			//find the max of the children
+			if(child + PQ_ARITY - 1 <= size){
+				best = child + SIFT_MAX(pq->prio + child);
+				STAT(compares += PQ_ARITY;)
+			}
+			else {
+				STAT(compares += size - child + 1;)
+				for(best = child++; child <= size; child++)
+					if(pq->prio[child] > pq->prio[best])
+						best = child;
+			}
+			if(!(pq->prio[best] > x))
+				break;
+			pq->prio[i] = pq->prio[best];
+			pq->ids[i] = pq->ids[best];
+			if(track)
+				pq->pos[pq->ids[i]] = i;
+			i = best;
+			STAT(levels++;)
+		}
+	}
+	pq->prio[i] = x;
+	pq->ids[i] = d;
+	if(track)
+		pq->pos[d] = i;
+	STAT(stat_sift(pq, levels, compares);)
+}
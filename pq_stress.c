@@ -0,0 +1,1143 @@
+#include "pq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+/* randomized differential stress test.
+ *
+ * a seeded generator produces a long mix of insert, change_priority,
+ * remove_by_id, get_priority, peek_top and delete_top calls, including
+ * ones that must fail (such as inserting an id that is already queued),
+ * and runs it against every backend next to a reference model. one call
+ * in 1024 is a rarer one: pq_reserve; pq_build (or _parallel or
+ * _stream, into the queue or a new one), pq_insert_bulk,
+ * pq_change_priorities or pq_offer_bulk on a batch of ids; pq_offer;
+ * pq_delete_top_k or pq_drain_sorted; pq_merge or pq_split with a
+ * second queue.
+ *
+ * the model is a lazy binary heap: every insert or priority change
+ * pushes a new versioned entry, and stale entries are skipped when they
+ * reach the top, so each step costs O(log n) and runs of millions of
+ * calls on large queues stay cheap (the _pq.c oracle scans the offset
+ * capacity on every delete).
+ *
+ * ties are allowed: a delete_top is correct when its priority is the
+ * best priority in the model and the model holds the returned id with
+ * that priority. the multiqueue is relaxed, so for it only the second
+ * half is checked. the radix engine is monotone, so its runs never use
+ * a priority behind the last deleted top. the timing wheel takes any
+ * priority, but those behind the top share one scanned slot, so it is
+ * run the way timeouts use it, monotone as well. for the min-max heap
+ * the model keeps a second lazy heap in the opposite order, and peeks
+ * and deletes go to either end. the growable backend starts out at a
+ * sixteenth of the capacity, so its ids run past the starting capacity
+ * and it grows under the run; growable_copy does the same on the malloc
+ * fallback, where growing copies the arrays. the top-K backend keeps a
+ * quarter of the capacity and takes its inserts through pq_offer, which
+ * every other backend must turn down.
+ *
+ * unless -b picks one backend, a few fixed checks run first for what
+ * the model does not cover: the counters of a -DPQ_STATS build of pq.c
+ * (skipped in other builds), a queue image saved, mapped, changed and
+ * mapped again, and queues placed with pq_create_in.
+ *
+ * backends report rejected calls on stdout, so stdout is discarded
+ * unless -v is given; mismatches go to stderr.
+ *
+ * usage: pq_stress [-s seed] [-n ops] [-c capacity] [-b backend] [-v]
+ *
+ * built with -DPQ_FUZZ this file is a libFuzzer target instead: the
+ * input bytes drive the generator and each input runs against every
+ * backend.
+ */
+
+typedef struct backend {
+	const char *name;
+	PQ * (*create)(int capacity, int min_heap);
+	int monotone;	//rejects priorities behind the last deleted top
+	int relaxed;	//delete_top and peek_top return an entry near the top
+	int keys;		//KEYS_* priorities the backend stores exactly
+	int both_ends;	//has pq_peek_bottom and pq_delete_bottom
+	int fixed;		//pq_reserve cannot raise the capacity (engine queues)
+	int topk;		//made by pq_create_topk with k = TOPK(capacity)
+	int merge;		//MOVE_* calls between two queues of the backend
+} BACKEND;
+
+enum { MOVE_NONE, MOVE_MERGE, MOVE_SPLIT };	//MOVE_SPLIT has pq_merge too
+
+#define TOPK(capacity)	((capacity) / 4 + 1)	//below the size the op mix settles at
+
+enum { KEYS_DOUBLE, KEYS_FLOAT, KEYS_UINT };
+
+enum { OP_INSERT, OP_CHANGE, OP_REMOVE, OP_GET, OP_PEEK, OP_DELETE,
+	OP_RESERVE, OP_BUILD, OP_INSERT_BULK, OP_DELETE_K, OP_DRAIN, OP_CHANGES,
+	OP_OFFER, OP_OFFER_BULK, OP_MERGE, OP_SPLIT };
+
+enum { BUILD_PLAIN, BUILD_PARALLEL, BUILD_STREAM };
+
+//the calls one in 1024 operations makes instead of a delete
+static const int rare_ops[] = { OP_RESERVE, OP_BUILD, OP_INSERT_BULK, OP_DELETE_K, OP_CHANGES,
+	OP_OFFER, OP_OFFER_BULK, OP_MERGE, OP_SPLIT };
+#define NRARE	((int)(sizeof(rare_ops) / sizeof(rare_ops[0])))
+
+typedef struct op {
+	int type;
+	int id;			//the capacity asked for with OP_RESERVE, id % 4 of those OP_SPLIT moves
+	double priority;
+	int bottom;		//OP_PEEK and OP_DELETE at the bottom end
+	int builder;	//BUILD_* call OP_BUILD makes
+	int fresh;		//OP_BUILD into a new queue of the backend
+	int n;			//batch of the bulk calls, in ids and priorities, or k
+	int *ids;
+	double *priorities;
+} OP;
+
+/* generator state. with data set, values are read from the buffer and
+ * the run ends when it is used up; otherwise they come from a xorshift
+ * sequence started at the seed.
+ */
+typedef struct source {
+	const unsigned char *data;
+	size_t len;
+	unsigned long long state;
+} SOURCE;
+
+typedef struct model_entry {
+	double priority;
+	int id;
+	unsigned version;
+} MODEL_ENTRY;
+
+typedef struct lazy_heap {
+	MODEL_ENTRY *heap;	//entries are live while their version is current
+	int n;
+	int room;
+	int min_heap;		//which end comes out first
+} LAZY_HEAP;
+
+typedef struct model {
+	LAZY_HEAP top;		//best entry first
+	LAZY_HEAP bottom;	//worst entry first, kept for double-ended backends only
+	int both_ends;
+	double *priority;	//current priority of every id
+	unsigned *version;
+	char *active;
+	char *mark;			//scratch for checking batches, all 0 between calls
+	int size;
+	int capacity;
+	int min_heap;
+} MODEL;
+
+//ids up to the full capacity, so most inserts grow the queue at first
+static PQ * create_growable(int capacity, int min_heap){
+	return pq_create_growable(capacity / 16 + 1, min_heap);
+}
+
+/* growable as above, but on the malloc fallback: the address space
+ * limit is lowered while it is created, so reserving room for
+ * PQ_MAX_CAPACITY ids fails and every growth copies the arrays, as in
+ * pq_bench_build. NULL if the limit cannot be set.
+ */
+static PQ * create_growable_copy(int capacity, int min_heap){
+	struct rlimit old, low;
+	long pages;
+	FILE *f;
+	PQ *pq;
+
+	if(getrlimit(RLIMIT_AS, &old) != 0 || (f = fopen("/proc/self/statm", "r")) == NULL)
+		return NULL;
+	if(fscanf(f, "%ld", &pages) != 1)
+		pages = -1;
+	fclose(f);
+	if(pages < 0)
+		return NULL;
+	//what is mapped now plus room for malloc's own bookkeeping
+	low = old;
+	low.rlim_cur = (rlim_t)pages * sysconf(_SC_PAGESIZE) + (64 << 20);
+	if(old.rlim_cur != RLIM_INFINITY && old.rlim_cur < low.rlim_cur)
+		low.rlim_cur = old.rlim_cur;
+	if(setrlimit(RLIMIT_AS, &low) != 0)
+		return NULL;
+	pq = create_growable(capacity, min_heap);
+	setrlimit(RLIMIT_AS, &old);
+	return pq;
+}
+
+static PQ * create_topk(int capacity, int min_heap){
+	return pq_create_topk(capacity, min_heap, TOPK(capacity));
+}
+
+static PQ * create_multiqueue(int capacity, int min_heap){
+	return pq_create_multiqueue(capacity, min_heap, 4);
+}
+
+static PQ * create_compact_float(int capacity, int min_heap){
+	return pq_create_compact(capacity, min_heap, PQ_KEY_FLOAT32);
+}
+
+static PQ * create_compact_uint(int capacity, int min_heap){
+	return pq_create_compact(capacity, min_heap, PQ_KEY_UINT32);
+}
+
+static PQ * create_wheel(int capacity, int min_heap){
+	return pq_create_wheel(capacity, min_heap, 64);
+}
+
+static PQ * create_bucket(int capacity, int min_heap){
+	return pq_create_bucket(capacity, min_heap, 0, 999999);
+}
+
+static PQ * create_lazy(int capacity, int min_heap){
+	PQ *pq = pq_create(capacity, min_heap);
+	pq_set_lazy_remove(pq, 0.5);
+	return pq;
+}
+
+static const BACKEND backends[] = {
+	{ "heap",			pq_create,				0, 0, KEYS_DOUBLE, 0, 0, 0, MOVE_SPLIT },
+	{ "growable",		create_growable,		0, 0, KEYS_DOUBLE, 0, 0, 0, MOVE_SPLIT },
+	{ "growable_copy",	create_growable_copy,	0, 0, KEYS_DOUBLE, 0, 0, 0, MOVE_SPLIT },
+	{ "pairing",		pq_create_pairing,		0, 0, KEYS_DOUBLE, 0, 1, 0, MOVE_MERGE },
+	{ "radix",			pq_create_radix,		1, 0, KEYS_DOUBLE, 0, 1, 0, MOVE_NONE },
+	{ "concurrent",		pq_create_concurrent,	0, 0, KEYS_DOUBLE, 0, 1, 0, MOVE_NONE },
+	{ "multiqueue",		create_multiqueue,		0, 1, KEYS_DOUBLE, 0, 1, 0, MOVE_NONE },
+	{ "compact_float",	create_compact_float,	0, 0, KEYS_FLOAT, 0, 1, 0, MOVE_NONE },
+	{ "compact_uint",	create_compact_uint,	0, 0, KEYS_UINT, 0, 1, 0, MOVE_NONE },
+	{ "wheel",			create_wheel,			1, 0, KEYS_DOUBLE, 0, 1, 0, MOVE_NONE },
+	{ "bucket",			create_bucket,			0, 0, KEYS_UINT, 0, 1, 0, MOVE_NONE },
+	{ "minmax",			pq_create_minmax,		0, 0, KEYS_DOUBLE, 1, 1, 0, MOVE_NONE },
+	{ "lazy",			create_lazy,			0, 0, KEYS_DOUBLE, 0, 0, 0, MOVE_SPLIT },
+	{ "topk",			create_topk,			0, 0, KEYS_DOUBLE, 0, 0, 1, MOVE_SPLIT },
+};
+#define NBACKENDS	((int)(sizeof(backends) / sizeof(backends[0])))
+
+
+static int next(SOURCE *s, unsigned *r){
+	if(s->data != NULL){
+		if(s->len < 4)
+			return 0;
+		memcpy(r, s->data, 4);
+		s->data += 4;
+		s->len -= 4;
+		return 1;
+	}
+	s->state ^= s->state << 13;
+	s->state ^= s->state >> 7;
+	s->state ^= s->state << 17;
+	*r = (unsigned)(s->state >> 32);
+	return 1;
+}
+
+static int better(int min_heap, double a, double b){
+	return min_heap ? a < b : a > b;
+}
+
+static void lazy_init(LAZY_HEAP *h, int min_heap){
+	h->room = 1024;
+	h->n = 0;
+	h->heap = malloc(sizeof(MODEL_ENTRY) * h->room);
+	h->min_heap = min_heap;
+}
+
+static void model_init(MODEL *m, int capacity, int min_heap, int both_ends){
+	lazy_init(&m->top, min_heap);
+	lazy_init(&m->bottom, !min_heap);
+	m->both_ends = both_ends;
+	m->priority = malloc(sizeof(double) * capacity);
+	m->version = calloc(capacity, sizeof(unsigned));
+	m->active = calloc(capacity, 1);
+	m->mark = calloc(capacity, 1);
+	m->size = 0;
+	m->capacity = capacity;
+	m->min_heap = min_heap;
+}
+
+static void model_free(MODEL *m){
+	free(m->top.heap);
+	free(m->bottom.heap);
+	free(m->priority);
+	free(m->version);
+	free(m->active);
+	free(m->mark);
+}
+
+static int live(MODEL *m, MODEL_ENTRY *e){
+	return m->active[e->id] && m->version[e->id] == e->version;
+}
+
+static void lazy_sift_down(LAZY_HEAP *h, int i){
+	MODEL_ENTRY x = h->heap[i];
+	int child;
+	while((child = 2 * i + 1) < h->n){
+		if(child + 1 < h->n && better(h->min_heap, h->heap[child + 1].priority, h->heap[child].priority))
+			child++;
+		if(!better(h->min_heap, h->heap[child].priority, x.priority))
+			break;
+		h->heap[i] = h->heap[child];
+		i = child;
+	}
+	h->heap[i] = x;
+}
+
+//pushes id's current entry, first dropping the stale entries and
+//re-heapifying once they outnumber the live ones
+static void lazy_push(MODEL *m, LAZY_HEAP *h, int id){
+	double priority = m->priority[id];
+	int i, n = 0;
+	if(h->n > 2 * m->size + 1024){
+		for(i = 0; i < h->n; i++)
+			if(live(m, &h->heap[i]))
+				h->heap[n++] = h->heap[i];
+		h->n = n;
+		for(i = n / 2 - 1; i >= 0; i--)
+			lazy_sift_down(h, i);
+	}
+	if(h->n == h->room){
+		h->room *= 2;
+		h->heap = realloc(h->heap, sizeof(MODEL_ENTRY) * h->room);
+	}
+	for(i = h->n++; i > 0 && better(h->min_heap, priority, h->heap[(i - 1) / 2].priority); i = (i - 1) / 2)
+		h->heap[i] = h->heap[(i - 1) / 2];
+	h->heap[i].priority = priority;
+	h->heap[i].id = id;
+	h->heap[i].version = m->version[id];
+}
+
+static void model_push(MODEL *m, int id, double priority){
+	m->active[id] = 1;
+	m->priority[id] = priority;
+	m->version[id]++;
+	lazy_push(m, &m->top, id);
+	if(m->both_ends)
+		lazy_push(m, &m->bottom, id);
+}
+
+static void model_remove(MODEL *m, int id){
+	m->active[id] = 0;
+	m->version[id]++;
+	m->size--;
+}
+
+//first live priority of h; the model must not be empty
+static double lazy_first(MODEL *m, LAZY_HEAP *h){
+	while(!live(m, &h->heap[0])){
+		h->heap[0] = h->heap[--h->n];
+		lazy_sift_down(h, 0);
+	}
+	return h->heap[0].priority;
+}
+
+static void model_clear(MODEL *m){
+	int id;
+	for(id = 0; id < m->capacity; id++)
+		if(m->active[id])
+			model_remove(m, id);
+}
+
+//whether op's batch repeats an id; *queued tells if one is in the model
+static int batch_repeats(MODEL *m, const OP *op, int *queued){
+	int i, repeats = 0;
+	*queued = 0;
+	for(i = 0; i < op->n; i++){
+		repeats |= m->mark[op->ids[i]];
+		*queued |= m->active[op->ids[i]];
+		m->mark[op->ids[i]] = 1;
+	}
+	for(i = 0; i < op->n; i++)
+		m->mark[op->ids[i]] = 0;
+	return repeats;
+}
+
+static double model_top(MODEL *m){
+	return lazy_first(m, &m->top);
+}
+
+static double model_bottom(MODEL *m){
+	return lazy_first(m, &m->bottom);
+}
+
+/* priority for id from the random value v. it is a whole number plus
+ * id / capacity as in gen_pairs, and the whole part is drawn from a
+ * small or a large range so both tie-heavy and mostly distinct runs
+ * come up. for monotone backends it is offset from floor, the priority
+ * of the last deleted top, in the direction the queue moves. compact
+ * backends get priorities they store exactly: rounded to float, or
+ * just the whole part with no sign.
+ */
+static double gen_priority(MODEL *m, const BACKEND *b, double floor, int id, unsigned v){
+	double offset = (v & 1) ? (v >> 1) % 16 : (v >> 1) % 1000000;
+	double priority;
+
+	if(b->keys == KEYS_UINT)
+		return offset;
+	offset += id / (double)m->capacity;
+	if(b->monotone)
+		priority = m->min_heap ? floor + offset : floor - offset;
+	else
+		priority = (v & 2) ? offset : -offset;
+	if(b->keys == KEYS_FLOAT)
+		priority = (float)priority;
+	return priority;
+}
+
+/* fills op's batch with up to n distinct ids, walked from a random
+ * start with a stride coprime to the capacity so any id can come up,
+ * and priorities for them. fresh batches skip the queued ids. one batch
+ * in 8 is then spoiled with a repeated id or, if fresh, a queued one,
+ * so the failure paths run too. monotone batches keep to the large
+ * range: the wheel scans its due slot for every top, and thousands of
+ * ties landing there at once would make each scan as long as the queue.
+ */
+static int gen_batch(SOURCE *s, MODEL *m, const BACKEND *b, double floor, OP *op, int n, int fresh){
+	unsigned r, v;
+	long id, stride, a, c, t;
+	int seen;
+
+	if(!next(s, &r) || !next(s, &v))
+		return 0;
+	id = r % m->capacity;
+	for(stride = 1 + v % m->capacity; ; stride++){
+		for(a = stride, c = m->capacity; c != 0; a = t)
+			t = c, c = a % c;
+		if(a == 1)
+			break;
+	}
+	op->n = 0;
+	for(seen = 0; op->n < n && seen < m->capacity; seen++, id = (id + stride) % m->capacity){
+		if(fresh && m->active[id])
+			continue;
+		if(!next(s, &v))
+			return 0;
+		op->ids[op->n] = id;
+		op->priorities[op->n++] = gen_priority(m, b, floor, id, b->monotone ? v & ~1u : v);
+	}
+	if(r >> 29 != 0 || op->n == 0)
+		return 1;
+	if(fresh && m->size > 0 && (v & 8)){
+		while(!m->active[id])
+			id = (id + stride) % m->capacity;
+		op->ids[(r >> 4) % op->n] = id;
+	}
+	else if(op->n > 1){
+		//with a priority of its own, which keeps ties between ids out
+		op->ids[op->n - 1] = op->ids[(r >> 4) % (op->n - 1)];
+		op->priorities[op->n - 1] = gen_priority(m, b, floor, op->ids[op->n - 1], b->monotone ? v & ~1u : v);
+	}
+	return 1;
+}
+
+//a few entries or a good share of the queue, from the random value x
+static int batch_size(MODEL *m, unsigned x){
+	if(x & 1)
+		return 1 + (x >> 1) % 16;
+	return 1 + m->size / 8 + (x >> 1) % (m->size / 4 + 16);
+}
+
+/* next operation for a queue in the state of the model, with priorities
+ * from gen_priority.
+ */
+static int gen_op(SOURCE *s, MODEL *m, const BACKEND *b, double floor, OP *op){
+	unsigned r, v, w;
+	int n;
+
+	if(!next(s, &r) || !next(s, &v))
+		return 0;
+	switch(r % 16){
+	case 0: case 1: case 2: case 3: case 4: case 5:
+		//a top-K queue is filled by offers, which then meet a full queue
+		op->type = b->topk ? OP_OFFER : OP_INSERT; break;
+	case 6: case 7: case 8:
+		op->type = OP_CHANGE; break;
+	case 9: case 10:
+		op->type = OP_REMOVE; break;
+	case 11:
+		op->type = OP_GET; break;
+	case 12:
+		op->type = OP_PEEK; break;
+	case 13: case 14:
+		op->type = OP_DELETE; break;
+	default:
+		//one in 64 of these is a rarer call
+		if(!next(s, &w))
+			return 0;
+		op->type = w % 64 != 0 ? OP_DELETE : rare_ops[(w >> 6) % NRARE];
+		break;
+	}
+	op->id = (r >> 4) % m->capacity;
+	switch(op->type){
+	case OP_RESERVE:
+		//up to twice the capacity, past what a fixed queue can reach
+		op->id = 1 + (r >> 4) % (2 * (unsigned)m->capacity);
+		return 1;
+	case OP_BUILD:
+		//around the current size, so the queue neither drains nor fills.
+		//the queue is emptied first, so monotone ones start again from 0
+		op->builder = (r >> 4) % 3;
+		op->fresh = (r >> 8) & 1;
+		n = m->size / 2 + (w >> 9) % (m->size + 16);
+		return gen_batch(s, m, b, 0, op, n < m->capacity ? n : m->capacity, 0);
+	case OP_INSERT_BULK:
+		return gen_batch(s, m, b, floor, op, batch_size(m, w >> 9), 1);
+	case OP_CHANGES:
+		//a few sifted changes or enough to rebuild the heap, queued or not
+		return gen_batch(s, m, b, floor, op, batch_size(m, w >> 9), 0);
+	case OP_OFFER_BULK:
+		return gen_batch(s, m, b, floor, op, batch_size(m, w >> 9), 0);
+	case OP_MERGE:
+	case OP_SPLIT:
+		//the other queue's entries
+		op->id = (r >> 4) % 4;
+		return gen_batch(s, m, b, floor, op, batch_size(m, w >> 9), 1);
+	case OP_DELETE_K:
+		//one in 8 empties the queue, which the builds and inserts refill
+		if((w >> 9) % 8 == 0)
+			op->type = OP_DRAIN;
+		op->n = batch_size(m, w >> 12);
+		return 1;
+	}
+	op->bottom = b->both_ends && (v & 4);	//v's low bits only shape priorities, unused by these ops
+	op->priority = gen_priority(m, b, floor, op->id, v);
+	return 1;
+}
+
+static int fail(const BACKEND *b, long step, const char *what, int id, double priority){
+	fprintf(stderr, "%s: step %ld: %s (id %d, priority %f)\n", b->name, step, what, id, priority);
+	return 0;
+}
+
+/* pq_offer on the model of a queue keeping k entries (none if k is 0):
+ * 1 if the candidate is taken. the top it may evict is a single id, as
+ * no two ids share a KEYS_DOUBLE priority.
+ */
+static int model_offer(MODEL *m, int k, int id, double priority){
+	int top;
+
+	if(k == 0)
+		return 0;
+	if(m->active[id]){
+		if(!better(!m->min_heap, priority, m->priority[id]))
+			return 0;
+		model_push(m, id, priority);
+		return 1;
+	}
+	if(m->size >= k){
+		model_top(m);
+		top = m->top.heap[0].id;
+		if(!better(!m->min_heap, priority, m->priority[top]))
+			return 0;
+		model_remove(m, top);
+	}
+	model_push(m, id, priority);
+	m->size++;
+	return 1;
+}
+
+//checks an entry a batch call took off the top and removes it from m
+static int took_top(const BACKEND *b, MODEL *m, long step, int id, double priority){
+	if(id < 0 || m->capacity <= id || !m->active[id] || m->priority[id] != priority)
+		return fail(b, step, "deleted entry is not in the queue", id, priority);
+	if(!b->relaxed && priority != model_top(m))
+		return fail(b, step, "deleted entry is not the best", id, priority);
+	model_remove(m, id);
+	return 1;
+}
+
+typedef struct stream {
+	const OP *op;
+	int next;
+} STREAM;
+
+static int stream_next(void *ctx, int *id, double *priority){
+	STREAM *s = ctx;
+	if(s->next == s->op->n)
+		return 0;
+	*id = s->op->ids[s->next];
+	*priority = s->op->priorities[s->next];
+	s->next++;
+	return 1;
+}
+
+//OP_BUILD through the builder it names; 2 threads are all one slice needs
+static int build(PQ *pq, const OP *op){
+	STREAM s = { op, 0 };
+	switch(op->builder){
+	case BUILD_PARALLEL:
+		return pq_build_parallel(pq, op->ids, op->priorities, op->n, 2);
+	case BUILD_STREAM:
+		return pq_build_stream(pq, stream_next, &s, 2);
+	}
+	return pq_build(pq, op->ids, op->priorities, op->n);
+}
+
+static int pick_quarter(int id, void *ctx){
+	return id % 4 == *(int *)ctx;
+}
+
+/* OP_MERGE and OP_SPLIT. a second queue of the same backend gets op's
+ * batch through pq_insert, and for a merge its last entry is removed
+ * again (a tombstone on lazy queues). it is then merged into pq, after
+ * which it must be empty and take its old ids again, or it takes the
+ * ids of pq that op->id picks, and must drain in order. a spoiled
+ * batch may share an id with pq, and then nothing may move.
+ */
+static int check_move(const BACKEND *b, MODEL *m, PQ *pq, OP *op, long step){
+	PQ *other = b->create(m->capacity, m->min_heap);
+	int i, id = -1, n = 0, expect, clash = 0, picked = 0, ok = 1;
+	double priority, last = 0;
+
+	for(i = 0; i < op->n; i++)
+		if(pq_insert(other, op->ids[i], op->priorities[i]))
+			id = op->ids[i];
+	if(op->type == OP_MERGE && id >= 0)
+		pq_remove_by_id(other, id);
+	//the batch becomes what other holds
+	for(i = 0; i < op->n; i++){
+		id = op->ids[i];
+		if(m->mark[id] || !pq_get_priority(other, id, &priority))
+			continue;
+		m->mark[id] = 1;
+		op->ids[n] = id;
+		op->priorities[n++] = priority;
+		clash |= m->active[id] && (op->type == OP_MERGE || pick_quarter(id, &op->id));
+	}
+	for(i = 0; i < n; i++)
+		m->mark[op->ids[i]] = 0;
+
+	if(op->type == OP_MERGE){
+		expect = b->merge != MOVE_NONE && !clash;
+		if(pq_merge(pq, other) != expect)
+			ok = fail(b, step, "merge result", -1, n);
+		else if(pq_size(other) != (expect ? 0 : n))
+			ok = fail(b, step, "size of the merged queue", -1, pq_size(other));
+		else if(expect && n > 0 && !pq_insert(other, op->ids[0], op->priorities[0]))
+			ok = fail(b, step, "merged queue keeps an id it gave up", op->ids[0], op->priorities[0]);
+		for(i = 0; ok && expect && i < n; i++, m->size++)
+			model_push(m, op->ids[i], op->priorities[i]);
+		pq_free(other);
+		return ok;
+	}
+
+	expect = b->merge == MOVE_SPLIT && !clash;
+	if(pq_split(pq, other, pick_quarter, &op->id) != expect)
+		ok = fail(b, step, "split result", -1, n);
+	for(id = 0; ok && expect && id < m->capacity; id++){
+		if(!m->active[id] || !pick_quarter(id, &op->id))
+			continue;
+		if(!pq_get_priority(other, id, &priority) || priority != m->priority[id])
+			ok = fail(b, step, "entry missing after the split", id, priority);
+		model_remove(m, id);
+		picked++;
+	}
+	for(i = 0; ok && i < n; i++)
+		if(!pq_get_priority(other, op->ids[i], &priority) || priority != op->priorities[i])
+			ok = fail(b, step, "split lost an entry of its target", op->ids[i], priority);
+	if(ok && pq_size(other) != n + picked)
+		ok = fail(b, step, "size of the split queue", -1, pq_size(other));
+	//other holds exactly what it should, so only its order is left
+	for(i = 0; ok && expect && !b->relaxed && pq_delete_top(other, &id, &priority); i++, last = priority)
+		if(i > 0 && better(m->min_heap, priority, last))
+			ok = fail(b, step, "split queue out of order", id, priority);
+	pq_free(other);
+	return ok;
+}
+
+/* runs the operations from s against one backend and returns 1 if it
+ * agreed with the model throughout, including when drained at the end.
+ */
+static int run(const BACKEND *b, SOURCE *s, long ops, int capacity, int min_heap){
+	PQ *pq = b->create(capacity, min_heap);
+	MODEL m;
+	OP op;
+	long step;
+	int id, i, ok = 1, expect, got, queued, k = b->topk ? TOPK(capacity) : 0;
+	double priority, floor = 0;
+
+	if(pq == NULL){
+		fprintf(stderr, "%s: cannot create the queue\n", b->name);
+		return 0;
+	}
+
+	model_init(&m, capacity, min_heap, b->both_ends);
+	op.ids = malloc(sizeof(int) * capacity);
+	op.priorities = malloc(sizeof(double) * capacity);
+	for(step = 0; ok && step < ops && gen_op(s, &m, b, floor, &op); step++){
+		switch(op.type){
+		case OP_INSERT:
+			expect = !m.active[op.id];
+			if(pq_insert(pq, op.id, op.priority) != expect)
+				ok = fail(b, step, "insert result", op.id, op.priority);
+			else if(expect){
+				model_push(&m, op.id, op.priority);
+				m.size++;
+			}
+			break;
+		case OP_CHANGE:
+			expect = m.active[op.id];
+			if(pq_change_priority(pq, op.id, op.priority) != expect)
+				ok = fail(b, step, "change_priority result", op.id, op.priority);
+			else if(expect)
+				model_push(&m, op.id, op.priority);
+			break;
+		case OP_REMOVE:
+			expect = m.active[op.id];
+			if(pq_remove_by_id(pq, op.id) != expect)
+				ok = fail(b, step, "remove_by_id result", op.id, 0);
+			else if(expect)
+				model_remove(&m, op.id);
+			break;
+		case OP_GET:
+			expect = m.active[op.id];
+			if(pq_get_priority(pq, op.id, &priority) != expect)
+				ok = fail(b, step, "get_priority result", op.id, 0);
+			else if(expect && priority != m.priority[op.id])
+				ok = fail(b, step, "get_priority value", op.id, priority);
+			break;
+		case OP_PEEK:
+		case OP_DELETE:
+			expect = m.size > 0;
+			if(op.bottom)
+				got = op.type == OP_PEEK ? pq_peek_bottom(pq, &id, &priority) : pq_delete_bottom(pq, &id, &priority);
+			else
+				got = op.type == OP_PEEK ? pq_peek_top(pq, &id, &priority) : pq_delete_top(pq, &id, &priority);
+			if(got != expect)
+				ok = fail(b, step, op.bottom ? "bottom result" : "top result", -1, 0);
+			else if(!expect)
+				break;
+			else if(id < 0 || capacity <= id || !m.active[id] || m.priority[id] != priority)
+				ok = fail(b, step, op.bottom ? "bottom is not in the queue" : "top is not in the queue", id, priority);
+			else if(op.bottom && priority != model_bottom(&m))
+				ok = fail(b, step, "bottom is not the worst entry", id, priority);
+			else if(!op.bottom && !b->relaxed && priority != model_top(&m))
+				ok = fail(b, step, "top is not the best entry", id, priority);
+			else if(op.type == OP_DELETE){
+				model_remove(&m, id);
+				if(!op.bottom)
+					floor = priority;
+			}
+			break;
+		case OP_RESERVE:
+			expect = op.id <= capacity || !b->fixed;
+			if(pq_reserve(pq, op.id) != expect)
+				ok = fail(b, step, "reserve result", op.id, 0);
+			break;
+		case OP_BUILD:
+			//a failed build leaves the queue empty. a new queue starts
+			//small, so a growable one grows while the pairs come in
+			expect = !batch_repeats(&m, &op, &queued);
+			if(op.fresh){
+				pq_free(pq);
+				pq = b->create(capacity, min_heap);
+			}
+			if(build(pq, &op) != expect){
+				ok = fail(b, step, "build result", -1, op.n);
+				break;
+			}
+			model_clear(&m);
+			floor = 0;
+			for(i = 0; expect && i < op.n; i++, m.size++)
+				model_push(&m, op.ids[i], op.priorities[i]);
+			break;
+		case OP_INSERT_BULK:
+			expect = !batch_repeats(&m, &op, &queued) && !queued;
+			if(pq_insert_bulk(pq, op.ids, op.priorities, op.n) != expect)
+				ok = fail(b, step, "insert_bulk result", -1, op.n);
+			for(i = 0; ok && expect && i < op.n; i++, m.size++)
+				model_push(&m, op.ids[i], op.priorities[i]);
+			break;
+		case OP_CHANGES:
+			//ids not queued are skipped, a repeated one keeps its last priority
+			for(i = expect = 0; i < op.n; i++)
+				expect += m.active[op.ids[i]];
+			if((got = pq_change_priorities(pq, op.ids, op.priorities, op.n)) != expect){
+				ok = fail(b, step, "change_priorities result", -1, got);
+				break;
+			}
+			for(i = 0; i < op.n; i++)
+				if(m.active[op.ids[i]])
+					model_push(&m, op.ids[i], op.priorities[i]);
+			break;
+		case OP_OFFER:
+			expect = model_offer(&m, k, op.id, op.priority);
+			if(pq_offer(pq, op.id, op.priority) != expect)
+				ok = fail(b, step, "offer result", op.id, op.priority);
+			break;
+		case OP_OFFER_BULK:
+			for(i = expect = 0; i < op.n; i++)
+				expect += model_offer(&m, k, op.ids[i], op.priorities[i]);
+			if((got = pq_offer_bulk(pq, op.ids, op.priorities, op.n)) != expect)
+				ok = fail(b, step, "offer_bulk result", -1, got);
+			break;
+		case OP_MERGE:
+		case OP_SPLIT:
+			ok = check_move(b, &m, pq, &op, step);
+			break;
+		case OP_DELETE_K:
+		case OP_DRAIN:
+			//the batch arrays take the deleted entries
+			expect = op.type == OP_DRAIN || m.size < op.n ? m.size : op.n;
+			if(op.type == OP_DRAIN)
+				got = pq_drain_sorted(pq, op.ids, op.priorities);
+			else
+				got = pq_delete_top_k(pq, op.n, op.ids, op.priorities);
+			if(got != expect)
+				ok = fail(b, step, op.type == OP_DRAIN ? "drain_sorted result" : "delete_top_k result", -1, got);
+			for(i = 0; ok && i < got; i++){
+				ok = took_top(b, &m, step, op.ids[i], op.priorities[i]);
+				floor = op.priorities[i];
+			}
+			break;
+		}
+		if(ok && pq_size(pq) != m.size)
+			ok = fail(b, step, "size", -1, 0);
+	}
+
+	//drain both, strictly ordered for every backend once nothing else runs
+	while(ok && m.size > 0){
+		if(!pq_delete_top(pq, &id, &priority))
+			ok = fail(b, step, "drain ended early", -1, 0);
+		else if(id < 0 || capacity <= id || !m.active[id] || m.priority[id] != priority)
+			ok = fail(b, step, "drained entry is not in the queue", id, priority);
+		else if(!b->relaxed && priority != model_top(&m))
+			ok = fail(b, step, "drained entry is not the best", id, priority);
+		else
+			model_remove(&m, id);
+	}
+	if(ok && pq_size(pq) != 0)
+		ok = fail(b, step, "size after drain", -1, 0);
+
+	free(op.ids);
+	free(op.priorities);
+	model_free(&m);
+	pq_free(pq);
+	return ok;
+}
+
+#ifdef PQ_FUZZ
+
+#define FUZZ_CAPACITY	64
+
+/* first byte picks min or max heap; the rest drive the generator. a
+ * small capacity keeps id collisions, and so the failure paths, common.
+ */
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size){
+	static int quiet;
+	SOURCE s;
+	int i;
+
+	if(!quiet){
+		quiet = freopen("/dev/null", "w", stdout) != NULL;
+	}
+	if(size < 1)
+		return 0;
+	for(i = 0; i < NBACKENDS; i++){
+		s.data = data + 1;
+		s.len = size - 1;
+		s.state = 0;
+		if(!run(&backends[i], &s, -1UL >> 1, FUZZ_CAPACITY, data[0] & 1))
+			abort();
+	}
+	return 0;
+}
+
+#else
+
+static int check_fail(const char *check, const char *what){
+	fprintf(stderr, "%s: %s\n", check, what);
+	return 0;
+}
+
+/* the counters after a known workload on a plain heap: every kind of
+ * call counted as many times as it was made, and the sifts behind them
+ * showing up in the compares, levels and histograms. a lazy queue adds
+ * a purged tombstone.
+ */
+static int check_stats(void){
+	static const int calls[PQ_STAT_PURGE] = { 1000, 100, 100, 100, 100, 1 };
+	PQ *pq = pq_create(1000, 1), *lazy = pq_create(1000, 1);
+	PQ_COUNTERS stats, zero;
+	int i, id, ids[100], ok = 1;
+	double priority, priorities[100];
+
+	for(i = 0; i < 1000; i++)
+		pq_insert(pq, i, i * 7919 % 1000);
+	for(i = 0; i < 100; i++){
+		pq_change_priority(pq, i, -1 - i);			//towards the top
+		pq_change_priority(pq, 100 + i, 2000 + i);	//away from it
+		pq_remove_by_id(pq, 200 + i);
+		ids[i] = 200 + i;
+		priorities[i] = i;
+	}
+	for(i = 0; i < 100; i++)
+		pq_delete_top(pq, &id, &priority);
+	pq_insert_bulk(pq, ids, priorities, 100);
+	if(!pq_stats(pq, &stats)){
+		fprintf(stderr, "stats: pq.c built without -DPQ_STATS, skipped\n");
+		pq_free(pq);
+		pq_free(lazy);
+		return 1;
+	}
+	for(i = 0; ok && i < PQ_STAT_PURGE; i++){
+		if(stats.ops[i].calls != (unsigned long long)calls[i])
+			ok = check_fail("stats", "calls");
+		else if(stats.ops[i].compares == 0 || stats.ops[i].moves == 0)
+			ok = check_fail("stats", "no compares or moves");
+		else if(stats.ops[i].levels == 0 && i != PQ_STAT_REMOVE && i != PQ_STAT_BULK)
+			ok = check_fail("stats", "no levels");
+	}
+	for(i = 1; ok && i < PQ_STATS_BUCKETS && stats.depth[i] == 0; i++)
+		;
+	if(ok && i == PQ_STATS_BUCKETS)
+		ok = check_fail("stats", "no sift deeper than 0 levels");
+	if(ok && stats.size[10] == 0)	//sizes 512 to 1023
+		ok = check_fail("stats", "size histogram");
+
+	memset(&zero, 0, sizeof(zero));
+	pq_stats_reset(pq);
+	if(ok && (!pq_stats(pq, &stats) || memcmp(&stats, &zero, sizeof(zero)) != 0))
+		ok = check_fail("stats", "reset");
+
+	//the top removed lazily is purged by the next delete
+	pq_set_lazy_remove(lazy, 0.5);
+	for(i = 0; i < 100; i++)
+		pq_insert(lazy, i, i);
+	pq_remove_by_id(lazy, 0);
+	pq_delete_top(lazy, &id, &priority);
+	if(ok && (!pq_stats(lazy, &stats) || stats.ops[PQ_STAT_PURGE].calls == 0))
+		ok = check_fail("stats", "purge");
+
+	pq_free(pq);
+	pq_free(lazy);
+	if(ok)
+		fprintf(stderr, "stats: ok\n");
+	return ok;
+}
+
+//empties a and b and tells whether they gave the same entries in order
+static int drains_match(PQ *a, PQ *b){
+	int n = pq_size(a), *ids_a, *ids_b, same;
+	double *priorities_a, *priorities_b;
+
+	if(pq_size(b) != n)
+		return 0;
+	ids_a = malloc(sizeof(int) * (n + 1));
+	ids_b = malloc(sizeof(int) * (n + 1));
+	priorities_a = malloc(sizeof(double) * (n + 1));
+	priorities_b = malloc(sizeof(double) * (n + 1));
+	same = pq_drain_sorted(a, ids_a, priorities_a) == n && pq_drain_sorted(b, ids_b, priorities_b) == n
+		&& memcmp(ids_a, ids_b, sizeof(int) * n) == 0 && memcmp(priorities_a, priorities_b, sizeof(double) * n) == 0;
+	free(ids_a);
+	free(ids_b);
+	free(priorities_a);
+	free(priorities_b);
+	return same;
+}
+
+/* a queue image through pq_save and pq_open_mapped: a read-only mapping
+ * drains like the saved queue and leaves the file as it was, and the
+ * changes made through a writable mapping are there for the next
+ * reader once pq_sync returns. ref follows along as a plain heap.
+ */
+static int check_image(void){
+	char path[] = "/tmp/pq_stress_XXXXXX";
+	PQ *pq = pq_create(1000, 0), *ref = pq_create(1000, 0), *ro, *rw;
+	int i, id, n, fd, ids[1000], ok = 1;
+	double priority, priorities[1000], p;
+
+	if((fd = mkstemp(path)) < 0){
+		perror(path);
+		return 0;
+	}
+	close(fd);
+	for(i = 0; i < 1000; i++)
+		pq_insert(pq, i, i * 7919 % 1000);
+	for(i = 0; i < 1000; i += 10)
+		pq_remove_by_id(pq, i);
+	n = pq_size(pq);
+	if(!pq_save(pq, path))
+		ok = check_fail("image", "save");
+	else if((ro = pq_open_mapped(path, 0)) == NULL)
+		ok = check_fail("image", "open read-only");
+	else {
+		if(pq_capacity(ro) != 1000 || pq_size(ro) != n)
+			ok = check_fail("image", "capacity or size");
+		else {
+			//ref gets the entries before pq is drained
+			pq_delete_top_k(pq, n, ids, priorities);
+			pq_build(ref, ids, priorities, n);
+			pq_build(pq, ids, priorities, n);
+			if(!drains_match(ro, pq))
+				ok = check_fail("image", "read-only drain");
+		}
+		pq_free(ro);
+	}
+
+	if(ok && (rw = pq_open_mapped(path, 1)) == NULL)
+		ok = check_fail("image", "open writable");
+	else if(ok){
+		if(pq_size(rw) != n)
+			ok = check_fail("image", "the read-only drain reached the file");
+		//half the deleted entries come back, so the size changes too
+		for(i = 0; ok && i < 100; i++){
+			if(!pq_delete_top(rw, &id, &priority) || !pq_delete_top(ref, &ids[i], &p) || id != ids[i] || priority != p)
+				ok = check_fail("image", "writable delete_top");
+			else if(i % 2 == 0){
+				pq_insert(rw, id, -priority);
+				pq_insert(ref, id, -priority);
+			}
+		}
+		if(ok && !pq_sync(rw))
+			ok = check_fail("image", "sync");
+		else if(ok){
+			if((ro = pq_open_mapped(path, 0)) == NULL || !drains_match(ro, ref))
+				ok = check_fail("image", "changes after sync");
+			if(ro != NULL)
+				pq_free(ro);
+		}
+		pq_free(rw);
+	}
+
+	unlink(path);
+	pq_free(pq);
+	pq_free(ref);
+	if(ok)
+		fprintf(stderr, "image: ok\n");
+	return ok;
+}
+
+typedef struct region_calls {
+	size_t allocated;
+	size_t released;
+} REGION_CALLS;
+
+static void * region_alloc(size_t bytes, void *ctx){
+	((REGION_CALLS *)ctx)->allocated = bytes;
+	return aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+static void region_release(void *mem, size_t bytes, void *ctx){
+	((REGION_CALLS *)ctx)->released = bytes;
+	free(mem);
+}
+
+//a queue in a region works like one from pq_create up to its capacity
+static int region_works(PQ *pq){
+	PQ *ref = pq_create(1000, 1);
+	int i, ok;
+
+	for(i = 0; i < 1000; i++){
+		pq_insert(pq, i, i * 7919 % 1000);
+		pq_insert(ref, i, i * 7919 % 1000);
+	}
+	ok = !pq_reserve(pq, 1001) && drains_match(pq, ref);
+	pq_free(ref);
+	return ok;
+}
+
+/* pq_create_in against pq_footprint: a caller buffer of exactly the
+ * footprint takes the queue and one byte less does not, the alloc
+ * callback is asked for the footprint and gets it back on pq_free, and
+ * a zeroed region maps memory itself with no NUMA binding.
+ */
+static int check_region(void){
+	size_t bytes = pq_footprint(1000);
+	REGION_CALLS calls = { 0, 0 };
+	PQ_REGION region;
+	void *buffer;
+	PQ *pq;
+	int ok = 1;
+
+	if(bytes == 0 || pq_footprint(0) != 0)
+		return check_fail("region", "footprint");
+	buffer = aligned_alloc(64, (bytes + 63) / 64 * 64);
+
+	memset(&region, 0, sizeof(region));
+	region.buffer = buffer;
+	region.length = bytes - 1;
+	if((pq = pq_create_in(1000, 1, &region)) != NULL){
+		ok = check_fail("region", "buffer shorter than the footprint");
+		pq_free(pq);
+	}
+	region.length = bytes;
+	pq = pq_create_in(1000, 1, &region);
+	if(ok && (pq == NULL || !region_works(pq)))
+		ok = check_fail("region", "buffer of the footprint");
+	if(pq != NULL)
+		pq_free(pq);
+
+	memset(&region, 0, sizeof(region));
+	region.alloc = region_alloc;
+	region.release = region_release;
+	region.ctx = &calls;
+	pq = pq_create_in(1000, 1, &region);
+	if(ok && (pq == NULL || !region_works(pq)))
+		ok = check_fail("region", "alloc callback");
+	if(pq != NULL)
+		pq_free(pq);
+	if(ok && (calls.allocated != bytes || calls.released != bytes))
+		ok = check_fail("region", "alloc callback size");
+
+	memset(&region, 0, sizeof(region));
+	pq = pq_create_in(1000, 1, &region);
+	if(ok && (pq == NULL || !region_works(pq)))
+		ok = check_fail("region", "zeroed region");
+	if(pq != NULL)
+		pq_free(pq);
+
+	free(buffer);
+	if(ok)
+		fprintf(stderr, "region: ok\n");
+	return ok;
+}
+
+int main(int argc, char **argv){
+	unsigned long long seed = 1;
+	long ops = 2000000;
+	int capacity = 100000;
+	const char *only = NULL;
+	int verbose = 0;
+	int opt, i, min_heap, failed = 0;
+	SOURCE s;
+
+	while((opt = getopt(argc, argv, "s:n:c:b:v")) != -1){
+		switch(opt){
+		case 's': seed = strtoull(optarg, NULL, 0); break;
+		case 'n': ops = atol(optarg); break;
+		case 'c': capacity = atoi(optarg); break;
+		case 'b': only = optarg; break;
+		case 'v': verbose = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-s seed] [-n ops] [-c capacity] [-b backend] [-v]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(!verbose && freopen("/dev/null", "w", stdout) == NULL){
+		perror("/dev/null");
+		return 1;
+	}
+
+	if(only == NULL){
+		failed |= !check_stats();
+		failed |= !check_image();
+		failed |= !check_region();
+	}
+	for(i = 0; i < NBACKENDS; i++){
+		if(only != NULL && strcmp(only, backends[i].name) != 0)
+			continue;
+		for(min_heap = 1; min_heap >= 0; min_heap--){
+			s.data = NULL;
+			s.len = 0;
+			s.state = seed * 0x9e3779b97f4a7c15ULL | 1;
+			if(run(&backends[i], &s, ops, capacity, min_heap))
+				fprintf(stderr, "%s %s-heap: %ld ops ok\n", backends[i].name, min_heap ? "min" : "max", ops);
+			else {
+				fprintf(stderr, "%s %s-heap: FAILED (seed %llu)\n", backends[i].name, min_heap ? "min" : "max", seed);
+				failed = 1;
+			}
+		}
+	}
+	return failed;
+}
+
+#endif
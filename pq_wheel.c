@@ -0,0 +1,333 @@
+#include "pq.h"
+#include "pq_engine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+/* hierarchical timing wheel engine, for timeout style queues where
+ * entries go in at "now + delta" and most of them are removed or
+ * rescheduled before they reach the top.
+ *
+ * priorities are cut into ticks of the width given at creation. the
+ * wheel keeps a current tick and LEVELS levels of SLOTS slots: level l
+ * holds the entries whose tick first differs from the current tick in
+ * the l-th group of SLOT_BITS bits, in the slot named by that group.
+ * ticks further out than the top level wait on an overflow list, and
+ * ticks at or before the current one share its slot on level 0.
+ *
+ * when the current slot runs empty the current tick jumps to the next
+ * occupied slot (one ctz per level) and that slot is cascaded down, so
+ * an entry moves at most LEVELS times between insert and delete_top.
+ * the top is found by scanning the due slot for the best priority, so
+ * entries come off in exactly the order pq_create gives; the tick only
+ * trades slot length against cascading.
+ *
+ * an entry put before the current tick (behind the top) is parked in
+ * the due slot; the next look at the top moves the current tick back to
+ * it and places every entry again. timeouts are inserted after the
+ * ones already due, so for them this is rare.
+ *
+ * every slot is a doubly linked list threaded through an array indexed
+ * by id, which gives O(1) insert, change_priority and remove_by_id.
+ */
+
+#define SLOT_BITS	6
+#define SLOTS		(1 << SLOT_BITS)		//one 64-bit occupancy word per level
+#define LEVELS		8					//the levels span 2^48 ticks
+#define OVERFLOW	(LEVELS * SLOTS)	//list of entries beyond the top level
+#define NIL			-1
+#define ABSENT		-1					//slot of an id that is not in the queue
+#define TICK_LIMIT	9.2e18				//ticks are clamped to +-TICK_LIMIT
+
+typedef struct wheel_node {
+	double key;		//priority, negated for a max-heap
+	uint64_t tick;	//tick of key, offset so ticks compare as unsigned
+	int prev;
+	int next;
+	int slot;
+} WHEEL_NODE;
+
+typedef struct wheel_struct {
+	WHEEL_NODE *nodes;				//one node per id
+	int head[OVERFLOW + 1];			//first id in each slot, slot = level * SLOTS + index
+	uint64_t occupied[LEVELS];		//bit i of word l set when slot i of level l is non-empty
+	uint64_t now;					//current tick
+	int behind;						//entries in the due slot with a tick before now
+	double width;					//priority range of one tick
+	double sign;					//1 for a min-heap, -1 for a max-heap
+	int size;
+	int capacity;
+} WHEEL;
+
+
+static uint64_t tick_of(WHEEL *w, double key){
+	double t = floor(key / w->width);
+	if(!(t > -TICK_LIMIT))
+		t = -TICK_LIMIT;
+	else if(t > TICK_LIMIT)
+		t = TICK_LIMIT;
+	return (uint64_t)(int64_t)t ^ (uint64_t)1 << 63;
+}
+
+//links id into the slot its tick belongs to relative to the current tick
+static void place(WHEEL *w, int id){
+	WHEEL_NODE *n = &w->nodes[id];
+	uint64_t diff = n->tick > w->now ? n->tick ^ w->now : 0;
+	int level, slot;
+
+	if(diff == 0)
+		slot = w->now & (SLOTS - 1);
+	else {
+		level = (63 - __builtin_clzll(diff)) / SLOT_BITS;
+		slot = level < LEVELS ? level * SLOTS + (int)(n->tick >> (level * SLOT_BITS) & (SLOTS - 1)) : OVERFLOW;
+	}
+	if(n->tick < w->now)
+		w->behind++;
+	n->slot = slot;
+	n->prev = NIL;
+	n->next = w->head[slot];
+	if(n->next != NIL)
+		w->nodes[n->next].prev = id;
+	w->head[slot] = id;
+	if(slot != OVERFLOW)
+		w->occupied[slot / SLOTS] |= (uint64_t)1 << (slot % SLOTS);
+}
+
+static void unlink_node(WHEEL *w, int id){
+	WHEEL_NODE *n = &w->nodes[id];
+	if(n->prev != NIL)
+		w->nodes[n->prev].next = n->next;
+	else {
+		w->head[n->slot] = n->next;
+		if(n->next == NIL && n->slot != OVERFLOW)
+			w->occupied[n->slot / SLOTS] &= ~((uint64_t)1 << (n->slot % SLOTS));
+	}
+	if(n->next != NIL)
+		w->nodes[n->next].prev = n->prev;
+	if(n->tick < w->now)
+		w->behind--;
+	n->slot = ABSENT;
+}
+
+//empties slot and places its entries again relative to the current tick
+static void cascade(WHEEL *w, int slot){
+	int id = w->head[slot], next;
+	w->head[slot] = NIL;
+	if(slot != OVERFLOW)
+		w->occupied[slot / SLOTS] &= ~((uint64_t)1 << (slot % SLOTS));
+	for(; id != NIL; id = next){
+		next = w->nodes[id].next;
+		place(w, id);
+	}
+}
+
+/* moves the current tick back to the earliest entry behind it and
+ * places every entry again, O(size + slots)
+ */
+static void rebase(WHEEL *w){
+	int slot, id, next, all = NIL;
+	uint64_t min = w->now;
+
+	for(id = w->head[w->now & (SLOTS - 1)]; id != NIL; id = w->nodes[id].next)
+		if(w->nodes[id].tick < min)
+			min = w->nodes[id].tick;
+	for(slot = 0; slot <= OVERFLOW; slot++){
+		for(id = w->head[slot]; id != NIL; id = next){
+			next = w->nodes[id].next;
+			w->nodes[id].next = all;
+			all = id;
+		}
+		w->head[slot] = NIL;
+	}
+	for(slot = 0; slot < LEVELS; slot++)
+		w->occupied[slot] = 0;
+	w->now = min;
+	w->behind = 0;
+	for(id = all; id != NIL; id = next){
+		next = w->nodes[id].next;
+		place(w, id);
+	}
+}
+
+/* returns the slot of the current tick after making it non-empty (the
+ * queue must be non-empty): the current tick moves up to the start of
+ * the next occupied slot, which is cascaded down, until level 0 is
+ * reached. only when every level is empty is the overflow list scanned.
+ */
+static int due_slot(WHEEL *w){
+	int level, shift, slot, id;
+	uint64_t later = 0, min;
+
+	if(w->behind > 0)
+		rebase(w);
+	while(w->head[slot = w->now & (SLOTS - 1)] == NIL){
+		for(level = 0; level < LEVELS; level++){
+			shift = level * SLOT_BITS;
+			later = w->occupied[level] & ~(uint64_t)1 << (w->now >> shift & (SLOTS - 1));
+			if(later != 0)
+				break;
+		}
+		if(level == LEVELS){
+			min = w->nodes[w->head[OVERFLOW]].tick;
+			for(id = w->head[OVERFLOW]; id != NIL; id = w->nodes[id].next)
+				if(w->nodes[id].tick < min)
+					min = w->nodes[id].tick;
+			w->now = min;
+			cascade(w, OVERFLOW);
+			continue;
+		}
+		w->now = (w->now >> shift >> SLOT_BITS << SLOT_BITS | (uint64_t)__builtin_ctzll(later)) << shift;
+		if(level > 0)
+			cascade(w, level * SLOTS + __builtin_ctzll(later));
+	}
+	return slot;
+}
+
+//id with the best priority in the due slot
+static int best_due(WHEEL *w){
+	int id, best = w->head[due_slot(w)];
+	for(id = w->nodes[best].next; id != NIL; id = w->nodes[id].next)
+		if(w->nodes[id].key < w->nodes[best].key)
+			best = id;
+	return best;
+}
+
+static int in_queue(WHEEL *w, int id){
+	return id >= 0 && id < w->capacity && w->nodes[id].slot != ABSENT;
+}
+
+static int wheel_insert(void *impl, int id, double priority){
+	WHEEL *w = impl;
+	WHEEL_NODE *n;
+	if(id < 0 || w->capacity <= id){
+		printf("ERROR: ID is out of Range!\n");
+		return 0;
+	}
+	n = &w->nodes[id];
+	if(n->slot != ABSENT){
+		printf("ERROR: ID is already occupied at the given position.\n");
+		return 0;
+	}
+	n->key = w->sign * priority;
+	n->tick = tick_of(w, n->key);
+	if(w->size == 0)
+		w->now = n->tick;	//an empty wheel can start over anywhere
+	place(w, id);
+	w->size++;
+	return 1;
+}
+
+static int wheel_change_priority(void *impl, int id, double new_priority){
+	WHEEL *w = impl;
+	WHEEL_NODE *n;
+	if(!in_queue(w, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	n = &w->nodes[id];
+	unlink_node(w, id);
+	n->key = w->sign * new_priority;
+	n->tick = tick_of(w, n->key);
+	place(w, id);
+	return 1;
+}
+
+static int wheel_remove_by_id(void *impl, int id){
+	WHEEL *w = impl;
+	if(!in_queue(w, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	unlink_node(w, id);
+	w->size--;
+	return 1;
+}
+
+static int wheel_get_priority(void *impl, int id, double *priority){
+	WHEEL *w = impl;
+	if(!in_queue(w, id)){
+		printf("ERROR: There is no such ID in PQ.\n");
+		return 0;
+	}
+	*priority = w->sign * w->nodes[id].key;
+	return 1;
+}
+
+/* moving the current tick forward is not visible from outside: later
+ * inserts before it land in the due slot and are still found there.
+ */
+static int wheel_peek_top(void *impl, int *id, double *priority){
+	WHEEL *w = impl;
+	if(w->size == 0){
+		printf("ERROR: The heap is empty!!\n");
+		return 0;
+	}
+	*id = best_due(w);
+	*priority = w->sign * w->nodes[*id].key;
+	return 1;
+}
+
+static int wheel_delete_top(void *impl, int *id, double *priority){
+	WHEEL *w = impl;
+	if(!wheel_peek_top(impl, id, priority))
+		return 0;
+	unlink_node(w, *id);
+	w->size--;
+	return 1;
+}
+
+static int wheel_size(void *impl){
+	return ((WHEEL *)impl)->size;
+}
+
+static void wheel_free(void *impl){
+	WHEEL *w = impl;
+	free(w->nodes);
+	free(w);
+}
+
+static const PQ_ENGINE wheel_engine = {
+	wheel_insert,
+	wheel_change_priority,
+	wheel_remove_by_id,
+	wheel_get_priority,
+	wheel_delete_top,
+	wheel_peek_top,
+	wheel_size,
+	wheel_free,
+	NULL,
+	NULL,
+	NULL
+};
+
+PQ * pq_create_wheel(int capacity, int min_heap, double tick){
+	WHEEL *w;
+	int i;
+	if(0 >= capacity){
+		printf("Capacity must be greater than 0!\n");
+		exit(1);
+	}
+	if(!(tick > 0)){
+		printf("Tick must be greater than 0!\n");
+		exit(1);
+	}
+	w = malloc(sizeof(WHEEL));
+	if(w == NULL || (w->nodes = malloc(sizeof(WHEEL_NODE) * capacity)) == NULL){
+		printf("ERROR: Out of memory!\n");
+		exit(1);
+	}
+	for(i = 0; i < capacity; i++)
+		w->nodes[i].slot = ABSENT;
+	for(i = 0; i <= OVERFLOW; i++)
+		w->head[i] = NIL;
+	for(i = 0; i < LEVELS; i++)
+		w->occupied[i] = 0;
+	w->now = 0;
+	w->behind = 0;
+	w->width = tick;
+	w->sign = min_heap ? 1 : -1;
+	w->size = 0;
+	w->capacity = capacity;
+	return pq_wrap(&wheel_engine, w, capacity, min_heap);
+}
@@ -2,41 +2,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-/* prints the priority queue */
+/* prints the priority queue, top first. the heap is opaque, so it is
+ * drained through pq_delete_top and filled back up afterwards
+ */
 void pq_print(PQ *pq){
 	printf("\n\n\t\t******Priority Queue******\n");
-	int max = pq->size, i;
+	int capacity = pq_capacity(pq), n = 0, i;
+	int *ids = malloc(sizeof(int) * capacity);
+	double *prio = malloc(sizeof(double) * capacity);
 	
-	printf("Index:\t\t");
-	for(i = 0; i <= pq->capacity; i++)
-		printf("%2d ", i);
+	printf("Capacity: %d\tSize: %d\n", capacity, pq_size(pq));
+	while(pq_size(pq) > 0 && pq_delete_top(pq, &ids[n], &prio[n]))
+		n++;
 	
-	printf("\nPointers:\t");
-	for(i = 0; i < pq->capacity; i++){
-		if(pq->nodePtrs[i] == NULL){
-			printf("%2.0d ", -1);
-			continue;
-		}
-		printf("%2.0f ", pq->nodePtrs[i]->priority);
-	}
-	printf(" -");
-	
-	printf("\n===============");
-	for(i = 0; i <= pq->capacity; i++)
+	printf("===============");
+	for(i = 0; i < n; i++)
 		printf("===");
 	
 	printf("\nID:\t\t");
-	for(i = 0; i <= max; i++)
-		printf("%2d ", pq->heap[i].id);
+	for(i = 0; i < n; i++)
+		printf("%2d ", ids[i]);
 	
 	printf("\nPriority:\t");
-	for(i = 0; i <= max; i++)
-		printf("%2.0f ", pq->heap[i].priority);
-	
-	printf("\nPosition:\t");
-	for(i = 0; i <= max; i++)
-		printf("%2d ", pq->heap[i].position);
+	for(i = 0; i < n; i++)
+		printf("%2.0f ", prio[i]);
 	
+	for(i = 0; i < n; i++)
+		pq_insert(pq, ids[i], prio[i]);
+	free(ids);
+	free(prio);
 	printf("\n");
 }
 //==================================================
@@ -62,7 +56,7 @@ int main(){
 	i++;
 	pq_print(pq);
 	printf("\n1. TESTING INSERT/PERC-UP");
-	printf("\n\t1a. Expected Heap: 7 11 25 12 33 50 55 21 55 80 34 51");
+	printf("\n\t1a. Expected Queue: 7 11 12 21 25 33 34 50 51 55 55 80");
     printf("\n\t1b. Expected: Error");
 	pq_insert(pq, 11, 60);
 	printf("\n\t1c. Expected: Error");
@@ -80,7 +74,7 @@ int main(){
 	if(pq_change_priority(pq, id, new_priority) == 1){
 		printf("\n3. TESTING CHANGE PRIORITY");
 		pq_print(pq);
-		printf("\n\t3a. Expected Heap: 7 11 50 12 33 51 55 21 55 80 34 90");
+		printf("\n\t3a. Expected Queue: 7 11 12 21 33 34 50 51 55 55 80 90");
 	}
 	//reset it back
 	new_priority = 25;
@@ -91,7 +85,7 @@ int main(){
 	id = 0;
 	if(pq_change_priority(pq, id, new_priority) == 1){
 		pq_print(pq);
-		printf("\n\t3b. Expected Heap: 11 12 25 21 33 50 55 90 55 80 34 51");
+		printf("\n\t3b. Expected Queue: 11 12 21 25 33 34 50 51 55 55 80 90");
 	}
 	printf("\n\t3c. Expected: ERROR");
 	pq_change_priority(pq, -1, new_priority);
@@ -104,13 +98,13 @@ int main(){
 	if(pq_remove_by_id(pq, id2) == 1){
 		printf("\n\n4. TESTING REMOVE BY ID");
 		pq_print(pq);
-		printf("\n\t4a. Expected Heap: 11 12 25 21 33 50 55 90 55 80 34");
+		printf("\n\t4a. Expected Queue: 11 12 21 25 33 34 50 55 55 80 90");
 	}  
 
    id2 = 1;
    if(pq_remove_by_id(pq, id2) == 1){
 	   pq_print(pq);
-	   printf("\n\t4b. Expected Heap: 12 21 25 34 33 50 55 90 55 80");
+	   printf("\n\t4b. Expected Queue: 12 21 25 33 34 50 55 55 80 90");
    }
    printf("\n\t4c. Expected: ERROR");
    pq_remove_by_id(pq, -1);
@@ -150,9 +144,9 @@ int main(){
    if(pq_delete_top(pq, &id4, &p) == 1){
 	   printf("\n\n6. TESTING DELETE TOP");
 	   pq_print(pq);
-	   printf("\n\t6a. Expected Heap: 21 33 25 34 80 50 55 90 55");
+	   printf("\n\t6a. Expected Queue: 21 25 33 34 50 55 55 80 90");
 	   printf("\n\t6a. Expected ID: 3\tExpected Priority: 12");
 	   printf("\n\t\tResult: ID: %d\tPriority: %2.0f", id4, p);
    } 
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file